@@ -6,16 +6,17 @@
  * Output:  estimate of integral from a to b of f(x)
  *          using n trapezoids.
  *
- * Compile: gcc -g -Wall -fopenmp -o omp_trap_1 omp_trap_1.c
- * Usage:   ./omp_trap_1 <number of threads>
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_trap_1 omp_trap_1.c -lm
+ * Usage:   ./omp_trap_1 <number of threads> [integrand]
  *
  * Notes:   
- *   1.  The function f(x) is hardwired.
+ *   1.  The function f(x) is chosen on the command line from the
+ *       library in comum/integrands.h (default x^2).
  *   2.  In this version, each thread explicitly computes the integral
  *       over its assigned subinterval, a critical directive is used
  *       for the global sum.
- *   3.  This version assumes that n is evenly divisible by the 
- *       number of threads
+ *   3.  n can be any (64-bit) number:  the trapezoids are split
+ *       among the threads by comum/partition.h
  *
  * IPP:  Section 5.2.1 (pp. 216 and ff.)
  */
@@ -24,26 +25,31 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/partition.h"
 
 void Usage(char* prog_name);
-double f(double x);    /* Function we're integrating */
-void Trap(double a, double b, int n, double* global_result_p);
+void Trap(double a, double b, long n, const integrand_t* fn,
+      double* global_result_p);
 
 int main(int argc, char* argv[]) {
    double  global_result = 0.0;  /* Store result in global_result */
    double  a, b;                 /* Left and right endpoints      */
-   int     n;                    /* Total number of trapezoids    */
+   long    n;                    /* Total number of trapezoids    */
    int     thread_count;
+   const integrand_t* fn;        /* Function we're integrating    */
 
-   if (argc != 2) Usage(argv[0]);
+   if (argc < 2 || argc > 3) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc == 3 ? argv[2] : NULL);
+   if (fn == NULL) Usage(argv[0]);
    printf("Enter a, b, and n\n");
-   scanf("%lf %lf %d", &a, &b, &n);
-   if (n % thread_count != 0) Usage(argv[0]);
+   scanf("%lf %lf %ld", &a, &b, &n);
 #  pragma omp parallel num_threads(thread_count) 
-   Trap(a, b, n, &global_result);
+   Trap(a, b, n, fn, &global_result);
 
-   printf("With n = %d trapezoids, our estimate\n", n);
+   printf("f(x) = %s\n", fn->formula);
+   printf("With n = %ld trapezoids, our estimate\n", n);
    printf("of the integral from %f to %f = %.14e\n",
       a, b, global_result);
    return 0;
@@ -56,25 +62,11 @@ int main(int argc, char* argv[]) {
  */
 void Usage(char* prog_name) {
 
-   fprintf(stderr, "usage: %s <number of threads>\n", prog_name);
-   fprintf(stderr, "   number of trapezoids must be evenly divisible by\n");
-   fprintf(stderr, "   number of threads\n");
+   fprintf(stderr, "usage: %s <number of threads> [integrand]\n", prog_name);
+   Integrand_list(stderr);
    exit(0);
 }  /* Usage */
 
-/*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input arg:   x
- * Return val:  f(x)
- */
-double f(double x) {
-   double return_val;
-
-   return_val = x*x;
-   return return_val;
-}  /* f */
-
 /*------------------------------------------------------------------
  * Function:    Trap
  * Purpose:     Use trapezoidal rule to estimate definite integral
@@ -82,25 +74,24 @@ double f(double x) {
  *    a: left endpoint
  *    b: right endpoint
  *    n: number of trapezoids
+ *    fn: function we're integrating
  * Output arg:
  *    integral:  estimate of integral from a to b of f(x)
  */
-void Trap(double a, double b, int n, double* global_result_p) {
-   double  h, x, my_result;
+void Trap(double a, double b, long n, const integrand_t* fn,
+      double* global_result_p) {
+   double  h, my_result;
    double  local_a, local_b;
-   int  i, local_n;
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
+   part_t part = Partition(n, my_rank, thread_count, PART_ALIGN);
 
+   if (part.count == 0) return;
    h = (b-a)/n; 
-   local_n = n/thread_count;  
-   local_a = a + my_rank*local_n*h; 
-   local_b = local_a + local_n*h; 
-   my_result = (f(local_a) + f(local_b))/2.0; 
-   for (i = 1; i <= local_n-1; i++) {
-     x = local_a + i*h;
-     my_result += f(x);
-   }
+   local_a = Part_left(a, h, part); 
+   local_b = Part_right(a, h, part); 
+   my_result = (fn->f(local_a) + fn->f(local_b))/2.0; 
+   my_result += fn->trap_sum(local_a, h, 1, part.count-1);
    my_result = my_result*h; 
 
    *global_result_p += my_result; 
@@ -0,0 +1,130 @@
+/* File:    omp_sum_bench.c
+ * Purpose: Compare the summation modes of comum/summation.h:  for
+ *          each mode and each n in n_min, 4*n_min, ..., up to n_max
+ *          estimate the integral with the trapezoidal rule and print
+ *          the time, the throughput and the error.
+ *
+ * Input:   a, b, n_min, n_max
+ * Output:  one line per (mode, n):  mode, n, time, samples per second
+ *          and the error against the exact integral (when the
+ *          primitive of f is known)
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_sum_bench omp_sum_bench.c -lm
+ * Usage:   ./omp_sum_bench <number of threads> [integrand]
+ *
+ * Notes:
+ *   1.  Each estimate is the best of REPS runs.
+ *   2.  The plain sum's error stops falling (and then grows) once the
+ *       rounding error of the sum dominates the O(h^2) error of the
+ *       rule;  the kahan and pairwise sums keep following h^2 to much
+ *       larger n, so the same accuracy needs fewer trapezoids.
+ *   3.  The work is split as in omp_trap2b (comum/partition.h).
+ *   4.  The repro mode gives the same bits for any number of threads;
+ *       compare its time with plain to see what that costs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/quad_rules.h"
+#include "../../comum/summation.h"
+#include "../../comum/partition.h"
+
+#define REPS 3
+
+void Usage(char* prog_name);
+double Estimate(double a, double b, long n, const integrand_t* fn,
+      int mode, int thread_count);
+
+int main(int argc, char* argv[]) {
+   double  a, b, exact, result = 0.0;
+   double  start, finish, best;
+   long    n, n_min, n_max;
+   int     thread_count, mode, rep;
+   const integrand_t* fn;
+   const integrand_t* mode_fn;
+   integrand_t fn_copy;
+
+   if (argc < 2 || argc > 3) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc == 3 ? argv[2] : NULL);
+   if (fn == NULL) Usage(argv[0]);
+   printf("Enter a, b, n_min and n_max\n");
+   scanf("%lf %lf %ld %ld", &a, &b, &n_min, &n_max);
+   if (n_min < 1) n_min = 1;
+   exact = Integrand_exact(fn, a, b);
+
+   printf("f(x) = %s\n", fn->formula);
+   printf("SIMD kernel: %s\n", Trap_simd_isa_name());
+   printf("%-9s %14s %10s %14s %12s\n", "mode", "n", "time",
+         "samples/s", "error");
+   for (mode = 0; mode < SUM_MODE_COUNT; mode++) {
+      mode_fn = Sum_integrand(fn, mode, &fn_copy);
+      for (n = n_min; n <= n_max; n *= 4) {
+         best = 1.0e300;
+         for (rep = 0; rep < REPS; rep++) {
+            start = omp_get_wtime();
+            result = Estimate(a, b, n, mode_fn, mode, thread_count);
+            finish = omp_get_wtime();
+            if (finish - start < best) best = finish - start;
+         }
+         printf("%-9s %14ld %10.4f %14.4e %12.4e\n", sum_mode_names[mode],
+               n, best, (n + 1)/best, fabs(result - exact));
+      }
+   }
+
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> [integrand]\n", prog_name);
+   Integrand_list(stderr);
+   exit(0);
+}  /* Usage */
+
+/*------------------------------------------------------------------
+ * Function:    Estimate
+ * Purpose:     Trapezoidal rule with n trapezoids on thread_count
+ *              threads, combining the threads' results as mode says
+ * Input args:  a, b, n, fn (already set up for mode), mode,
+ *              thread_count
+ * Return val:  estimate of integral from a to b of f(x)
+ */
+double Estimate(double a, double b, long n, const integrand_t* fn,
+      int mode, int thread_count) {
+   const quad_rule_t* trap = Rule_find("trap");
+   double  h = (b-a)/n, plain = 0.0;
+   sum2_t  comp = SUM2_ZERO;
+   repro_t exact = REPRO_ZERO;
+
+#  pragma omp parallel num_threads(thread_count) \
+      reduction(+: plain) reduction(sum2: comp) reduction(repro: exact)
+   {
+      part_t part = Partition(n, omp_get_thread_num(),
+            omp_get_num_threads(),
+            mode == SUM_REPRO ? REPRO_BLOCK : PART_ALIGN);
+      double my_result;
+
+      if (mode == SUM_REPRO) {
+         Rule_panels_repro(&exact, trap, fn, a, h, n, part);
+      } else {
+         my_result = Rule_panels(trap, fn, Part_left(a, h, part),
+               Part_right(a, h, part), part.count, h);
+         if (mode == SUM_PLAIN)
+            plain += my_result;
+         else
+            Sum2_add(&comp, my_result);
+      }
+   }
+
+   if (mode == SUM_REPRO) return Repro_value(&exact);
+   return (mode == SUM_PLAIN) ? plain : Sum2_value(comp);
+}  /* Estimate */
@@ -0,0 +1,233 @@
+/* File:    omp_sync_bench.c
+ * Purpose: Compare the ways the OpenMP trapezoidal rule programs
+ *          combine the threads' work, on this host:
+ *
+ *             critical   each thread sums its block and adds it to
+ *                        the result in a critical section (omp_trap1)
+ *             reduction  the same, with a reduction clause (omp_trap2b)
+ *             for        parallel for over the samples with
+ *                        schedule(runtime) (omp_trap3), for each
+ *                        schedule kind and chunk size
+ *
+ *          for thread counts 1, 2, 4, ... up to the given maximum and
+ *          n = n_min, 4*n_min, ... up to n_max.
+ *
+ * Input:   a, b, n_min, n_max
+ * Output:  One record per (strategy, schedule, chunk, threads, n), as
+ *          CSV (default) or JSON lines:  the median, 95th percentile
+ *          and minimum of the times of BENCH_TRIALS runs, the samples
+ *          per second (at the median) and the estimate.  The prompt
+ *          goes to stderr, so stdout holds only the records.
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_sync_bench omp_sync_bench.c -lm
+ * Usage:   ./omp_sync_bench <max threads> [integrand [csv|json]]
+ *
+ * Notes:
+ *   1.  Each configuration is run BENCH_WARMUP times untimed (to
+ *       start the threads and warm the caches), then BENCH_TRIALS
+ *       times timed.  A time covers the whole parallel region, fork
+ *       and join included.
+ *   2.  Every strategy calls fn->f once per sample, as omp_trap3 does
+ *       (without its printf per iteration), so the records differ
+ *       only in how the work is split and combined, not in how f is
+ *       evaluated.  (The SIMD kernels would only be usable for the
+ *       blocks of critical and reduction.)
+ *   3.  Chunk 0 means the implementation's default chunk for the
+ *       schedule kind.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/partition.h"
+
+#define BENCH_WARMUP 2
+#define BENCH_TRIALS 21   /* Odd, and enough that p95 isn't the max */
+
+enum {STRAT_CRITICAL, STRAT_REDUCTION, STRAT_FOR};
+static const char* strat_names[] = {"critical", "reduction", "for"};
+
+static const struct {const char* name; omp_sched_t kind;} bench_scheds[] = {
+   {"static", omp_sched_static},
+   {"dynamic", omp_sched_dynamic},
+   {"guided", omp_sched_guided},
+};
+static const int bench_chunks[] = {0, 1, 64, 4096};
+
+#define SCHED_COUNT ((int) (sizeof(bench_scheds)/sizeof(bench_scheds[0])))
+#define CHUNK_COUNT ((int) (sizeof(bench_chunks)/sizeof(bench_chunks[0])))
+
+void Usage(char* prog_name);
+double Run(int strategy, double a, double b, long n, const integrand_t* fn,
+      int thread_count);
+double Block_trap(double a, double h, long n, const integrand_t* fn);
+void Bench(int strategy, int sched, int chunk, double a, double b, long n,
+      const integrand_t* fn, int thread_count, int json);
+void Print_record(int json, int strategy, const char* sched, int chunk,
+      int thread_count, long n, const double times[], double result);
+
+int main(int argc, char* argv[]) {
+   double  a, b;
+   long    n, n_min, n_max;
+   int     max_threads, thread_count, json = 0, s, c;
+   const integrand_t* fn;
+
+   if (argc < 2 || argc > 4) Usage(argv[0]);
+   max_threads = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc >= 3 ? argv[2] : NULL);
+   if (argc == 4) {
+      if (strcmp(argv[3], "json") == 0) json = 1;
+      else if (strcmp(argv[3], "csv") != 0) Usage(argv[0]);
+   }
+   if (fn == NULL || max_threads < 1) Usage(argv[0]);
+   fprintf(stderr, "Enter a, b, n_min and n_max\n");
+   if (scanf("%lf %lf %ld %ld", &a, &b, &n_min, &n_max) != 4) Usage(argv[0]);
+   if (n_min < 1) n_min = 1;
+
+   if (!json)
+      printf("strategy,schedule,chunk,threads,n,median_s,p95_s,min_s,"
+            "samples_per_s,estimate\n");
+   for (thread_count = 1; ; thread_count *= 2) {
+      if (thread_count > max_threads) thread_count = max_threads;
+      for (n = n_min; n <= n_max; n *= 4) {
+         Bench(STRAT_CRITICAL, -1, 0, a, b, n, fn, thread_count, json);
+         Bench(STRAT_REDUCTION, -1, 0, a, b, n, fn, thread_count, json);
+         for (s = 0; s < SCHED_COUNT; s++)
+            for (c = 0; c < CHUNK_COUNT; c++)
+               Bench(STRAT_FOR, s, bench_chunks[c], a, b, n, fn,
+                     thread_count, json);
+      }
+      if (thread_count == max_threads) break;
+   }
+
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <max threads> [integrand [csv|json]]\n",
+         prog_name);
+   Integrand_list(stderr);
+   exit(0);
+}  /* Usage */
+
+/*------------------------------------------------------------------
+ * Function:    Run
+ * Purpose:     Trapezoidal rule with n trapezoids on thread_count
+ *              threads, combined as strategy says (for STRAT_FOR the
+ *              schedule is the one set by omp_set_schedule)
+ * Return val:  estimate of integral from a to b of f(x)
+ */
+double Run(int strategy, double a, double b, long n, const integrand_t* fn,
+      int thread_count) {
+   double h = (b-a)/n, result = 0.0;
+   long   i;
+
+   if (strategy == STRAT_FOR) {
+      result = (fn->f(a) + fn->f(b))/2.0;
+#     pragma omp parallel for num_threads(thread_count) \
+         reduction(+: result) schedule(runtime)
+      for (i = 1; i <= n-1; i++)
+         result += fn->f(a + i*h);
+      return h*result;
+   }
+
+   if (strategy == STRAT_CRITICAL) {
+#     pragma omp parallel num_threads(thread_count) \
+         default(none) shared(a, h, n, fn, result)
+      {
+         double my_result = Block_trap(a, h, n, fn);
+#        pragma omp critical (result)
+         result += my_result;
+      }
+   } else {
+#     pragma omp parallel num_threads(thread_count) \
+         default(none) shared(a, h, n, fn) reduction(+: result)
+      result += Block_trap(a, h, n, fn);
+   }
+   return result;
+}  /* Run */
+
+/*------------------------------------------------------------------
+ * Function:    Block_trap
+ * Purpose:     The calling thread's part of the trapezoidal rule:  its
+ *              block of the n trapezoids (comum/partition.h), with one
+ *              call of fn->f per sample
+ */
+double Block_trap(double a, double h, long n, const integrand_t* fn) {
+   part_t part = Partition(n, omp_get_thread_num(), omp_get_num_threads(),
+         PART_ALIGN);
+   double local_a = Part_left(a, h, part), my_result;
+   long   i;
+
+   if (part.count == 0) return 0.0;
+   my_result = (fn->f(local_a) + fn->f(Part_right(a, h, part)))/2.0;
+   for (i = 1; i <= part.count-1; i++)
+      my_result += fn->f(local_a + i*h);
+   return h*my_result;
+}  /* Block_trap */
+
+static int Compare_doubles(const void* x, const void* y) {
+   double a = *(const double*) x, b = *(const double*) y;
+
+   return (a > b) - (a < b);
+}  /* Compare_doubles */
+
+/*------------------------------------------------------------------
+ * Function:    Bench
+ * Purpose:     Warm up, time BENCH_TRIALS runs of one configuration
+ *              and print its record
+ * In args:     sched:  index into bench_scheds (STRAT_FOR only)
+ *              chunk:  chunk size, 0 for the default (STRAT_FOR only)
+ */
+void Bench(int strategy, int sched, int chunk, double a, double b, long n,
+      const integrand_t* fn, int thread_count, int json) {
+   double times[BENCH_TRIALS], start, result = 0.0;
+   int trial;
+
+   if (strategy == STRAT_FOR)
+      omp_set_schedule(bench_scheds[sched].kind, chunk);
+   for (trial = 0; trial < BENCH_WARMUP; trial++)
+      result = Run(strategy, a, b, n, fn, thread_count);
+   for (trial = 0; trial < BENCH_TRIALS; trial++) {
+      start = omp_get_wtime();
+      result = Run(strategy, a, b, n, fn, thread_count);
+      times[trial] = omp_get_wtime() - start;
+   }
+
+   qsort(times, BENCH_TRIALS, sizeof(double), Compare_doubles);
+   Print_record(json, strategy,
+         strategy == STRAT_FOR ? bench_scheds[sched].name : "none",
+         chunk, thread_count, n, times, result);
+}  /* Bench */
+
+/*------------------------------------------------------------------
+ * Function:    Print_record
+ * Purpose:     Print one result as a CSV line or a JSON object
+ * In args:     times:  the BENCH_TRIALS times, sorted
+ */
+void Print_record(int json, int strategy, const char* sched, int chunk,
+      int thread_count, long n, const double times[], double result) {
+   double median = times[BENCH_TRIALS/2];
+   double p95 = times[(95*BENCH_TRIALS + 99)/100 - 1];   /* Nearest rank */
+   double rate = (n + 1)/median;
+
+   if (json)
+      printf("{\"strategy\": \"%s\", \"schedule\": \"%s\", \"chunk\": %d, "
+            "\"threads\": %d, \"n\": %ld, \"median_s\": %.6e, "
+            "\"p95_s\": %.6e, \"min_s\": %.6e, \"samples_per_s\": %.6e, "
+            "\"estimate\": %.15e}\n", strat_names[strategy], sched, chunk,
+            thread_count, n, median, p95, times[0], rate, result);
+   else
+      printf("%s,%s,%d,%d,%ld,%.6e,%.6e,%.6e,%.6e,%.15e\n",
+            strat_names[strategy], sched, chunk, thread_count, n, median,
+            p95, times[0], rate, result);
+   fflush(stdout);
+}  /* Print_record */
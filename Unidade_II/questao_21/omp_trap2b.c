@@ -4,60 +4,130 @@
  *
  * Input:   a, b, n
  * Output:  estimate of integral from a to b of f(x)
- *          using n trapezoids.
+ *          using n trapezoids (or n panels of another rule).
  *
- * Compile: gcc -g -Wall -fopenmp -o omp_trap2b omp_trap2b.c
- * Usage:   ./omp_trap2b <number of threads>
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_trap2b omp_trap2b.c -lm
+ * Usage:   ./omp_trap2b <number of threads> [integrand [rule [summation]]]
  *
  * Notes:   
- *   1.  The function f(x) is hardwired.
- *   2.  This version assumes that n is evenly divisible by the 
- *       number of threads
+ *   1.  The function f(x) is chosen on the command line from the
+ *       library in comum/integrands.h (default x^2).
+ *   2.  n can be any (64-bit) number:  the panels are split among
+ *       the threads by comum/partition.h
+ *   3.  The sum in Local_trap is done by the integrand's SIMD kernel
+ *       (AVX-512, AVX2 or scalar, chosen at run time).  See
+ *       comum/trap_simd.h.
+ *   4.  The rule applied to each thread's panels can be the
+ *       trapezoidal rule (default), Simpson, Boole or Gauss-Legendre.
+ *       See comum/quad_rules.h.
+ *   5.  The summation mode (plain, kahan, pairwise or repro) applies to
+ *       the sums in Local_trap;  with kahan or pairwise the threads'
+ *       results are also combined with a compensated reduction.  With
+ *       repro the threads get whole blocks of REPRO_BLOCK panels and
+ *       their exact accumulators are combined by a reduction(repro),
+ *       so the result has the same bits for any number of threads.
+ *       See comum/summation.h.
+ *   6.  If the environment variable TRAP_CACHE names a directory, the
+ *       trapezoidal rule uses the result cache kept there:  a repeated
+ *       query is answered from the cache, and n*2^k only computes
+ *       the samples that are new since n.  The entries are kept per
+ *       summation mode;  repro doesn't use the cache, whose sums
+ *       aren't exact.  See comum/trap_cache.h.
  *
  * IPP:  Section 5.4 (pp. 223 and ff.)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/quad_rules.h"
+#include "../../comum/summation.h"
+#include "../../comum/partition.h"
+#include "../../comum/trap_cache.h"
 
 void Usage(char* prog_name);
-double f(double x);    /* Function we're integrating */
-double Local_trap(double a, double b, int n);
+double Local_trap(double a, double b, long n, const integrand_t* fn,
+      const quad_rule_t* rule);
+void Local_repro(double a, double b, long n, const integrand_t* fn,
+      const quad_rule_t* rule, repro_t* acc);
+double Cached_trap(const char* dir, double a, double b, long n,
+      const integrand_t* fn, int mode, int thread_count, char* status);
 
 int main(int argc, char* argv[]) {
    double  global_result = 0.0;  /* Store result in global_result */
+   sum2_t  global_sum2 = SUM2_ZERO; /* Compensated global_result  */
+   repro_t global_repro = REPRO_ZERO; /* Exact global_result      */
    double  a, b;                 /* Left and right endpoints      */
-   int     n;                    /* Total number of trapezoids    */
+   long    n;                    /* Total number of panels        */
    int     thread_count;
-   double start, finish, global_time;
+   const integrand_t* fn;        /* Function we're integrating    */
+   const quad_rule_t* rule;      /* Rule applied to each panel    */
+   int     mode;                 /* Summation mode                */
+   integrand_t fn_copy;          /* fn with mode's trap_sum       */
+   double start, finish, global_time = 0.0;
+   const char* cache_dir;        /* $TRAP_CACHE, if set           */
+   char    cache_status[64] = "not used with this rule or summation";
 
-   if (argc != 2) Usage(argv[0]);
+   if (argc < 2 || argc > 5) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc >= 3 ? argv[2] : NULL);
+   rule = Rule_find(argc >= 4 ? argv[3] : NULL);
+   mode = Sum_mode_find(argc == 5 ? argv[4] : NULL);
+   if (fn == NULL || rule == NULL || mode == SUM_BAD_MODE) Usage(argv[0]);
+   fn = Sum_integrand(fn, mode, &fn_copy);
    printf("Enter a, b, and n\n");
-   scanf("%lf %lf %d", &a, &b, &n);
-   if (n % thread_count != 0) Usage(argv[0]);
-
-#  pragma omp parallel num_threads(thread_count) \
-      default (none) private(start, finish) shared(a, b, n, global_time) reduction(+: global_result)
-   {
-   #  pragma omp barrier
-      start = omp_get_wtime();   
-      global_result += Local_trap(a, b, n);
-      finish = omp_get_wtime();
-      int thread_number = omp_get_thread_num();
-      printf("Thread %d Processing time: %f \n", thread_number, (finish-start));
-      if(global_time < (finish-start)){
-#        pragma omp critical (time)
-         global_time = (finish-start);
+   scanf("%lf %lf %ld", &a, &b, &n);
+
+   cache_dir = getenv("TRAP_CACHE");
+   if (cache_dir != NULL && strcmp(rule->name, "trap") == 0
+         && mode != SUM_REPRO) {
+      start = omp_get_wtime();
+      global_result = Cached_trap(cache_dir, a, b, n, fn, mode,
+            thread_count, cache_status);
+      global_time = omp_get_wtime() - start;
+   } else {
+#     pragma omp parallel num_threads(thread_count) \
+         default (none) private(start, finish) shared(a, b, n, fn, rule, mode, global_time) \
+         reduction(+: global_result) reduction(sum2: global_sum2) \
+         reduction(repro: global_repro)
+      {
+         double my_result;
+      #  pragma omp barrier
+         start = omp_get_wtime();   
+         if (mode == SUM_REPRO) {
+            Local_repro(a, b, n, fn, rule, &global_repro);
+         } else {
+            my_result = Local_trap(a, b, n, fn, rule);
+            if (mode == SUM_PLAIN)
+               global_result += my_result;
+            else
+               Sum2_add(&global_sum2, my_result);
+         }
+         finish = omp_get_wtime();
+         int thread_number = omp_get_thread_num();
+         printf("Thread %d Processing time: %f \n", thread_number, (finish-start));
+         if(global_time < (finish-start)){
+#           pragma omp critical (time)
+            global_time = (finish-start);
+         }
       }
+      if (mode == SUM_REPRO)
+         global_result = Repro_value(&global_repro);
+      else if (mode != SUM_PLAIN)
+         global_result = Sum2_value(global_sum2);
    }
    
    
    printf("Processing time: %f \n", global_time);
+   printf("SIMD kernel: %s\n", Trap_simd_isa_name());
+   printf("Summation: %s\n", sum_mode_names[mode]);
+   if (cache_dir != NULL) printf("Cache: %s\n", cache_status);
 
-   printf("With n = %d trapezoids, our estimate\n", n);
+   printf("f(x) = %s\n", fn->formula);
+   printf("With n = %ld %s, our estimate\n", n, rule->panels);
    printf("of the integral from %f to %f = %.14e\n",
       a, b, global_result);
    return 0;
@@ -70,56 +140,105 @@ int main(int argc, char* argv[]) {
  */
 void Usage(char* prog_name) {
 
-   fprintf(stderr, "usage: %s <number of threads>\n", prog_name);
-   fprintf(stderr, "   number of trapezoids must be evenly divisible by\n");
-   fprintf(stderr, "   number of threads\n");
+   fprintf(stderr, "usage: %s <number of threads> [integrand [rule [summation]]]\n", prog_name);
+   Integrand_list(stderr);
+   Rule_list(stderr);
+   Sum_mode_list(stderr);
    exit(0);
 }  /* Usage */
 
-/*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input arg:   x
- * Return val:  f(x)
- */
-double f(double x) {
-   double return_val;
-
-   return_val = x*x;
-   return return_val;
-}  /* f */
-
 /*------------------------------------------------------------------
  * Function:    Local_trap
- * Purpose:     Use trapezoidal rule to estimate part of a definite 
- *              integral
+ * Purpose:     Use trapezoidal rule (or another rule) to estimate
+ *              part of a definite integral
  * Input args:  
  *    a: left endpoint
  *    b: right endpoint
- *    n: number of trapezoids
+ *    n: number of trapezoids (panels)
+ *    fn: function we're integrating
+ *    rule: rule applied to each panel
  * Return val:  estimate of integral from local_a to local_b
  *
  * Note:        return value should be added in to an OpenMP
  *              reduction variable to get estimate of entire
  *              integral
  */
-double Local_trap(double a, double b, int n) {
-   double  h, x, my_result;
+double Local_trap(double a, double b, long n, const integrand_t* fn,
+      const quad_rule_t* rule) {
+   double  h, my_result;
    double  local_a, local_b;
-   int  i, local_n;
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
+   part_t part = Partition(n, my_rank, thread_count, PART_ALIGN);
 
    h = (b-a)/n; 
-   local_n = n/thread_count;  
-   local_a = a + my_rank*local_n*h; 
-   local_b = local_a + local_n*h; 
-   my_result = (f(local_a) + f(local_b))/2.0; 
-   for (i = 1; i <= local_n-1; i++) {
-     x = local_a + i*h;
-     my_result += f(x);
-   }
-   my_result = my_result*h; 
+   local_a = Part_left(a, h, part); 
+   local_b = Part_right(a, h, part); 
+   my_result = Rule_panels(rule, fn, local_a, local_b, part.count, h);
 
    return my_result;
 }  /* Trap */
+
+/*------------------------------------------------------------------
+ * Function:    Local_repro
+ * Purpose:     Add the calling thread's part of the rule to acc, for
+ *              the repro summation mode:  the threads get whole
+ *              blocks of REPRO_BLOCK panels (comum/quad_rules.h)
+ * Input args:  a, b, n, fn, rule
+ * In/out arg:  acc:  the thread's private copy of the reduction
+ *              variable
+ */
+void Local_repro(double a, double b, long n, const integrand_t* fn,
+      const quad_rule_t* rule, repro_t* acc) {
+   part_t part = Partition(n, omp_get_thread_num(), omp_get_num_threads(),
+         REPRO_BLOCK);
+
+   Rule_panels_repro(acc, rule, fn, a, (b-a)/n, n, part);
+}  /* Local_repro */
+
+/*------------------------------------------------------------------
+ * Function:    Cached_trap
+ * Purpose:     Trapezoidal rule using the cache in dir:  the levels
+ *              missing from the cache entry are computed, with the
+ *              new samples of each level split among the threads
+ * Input args:  dir, a, b, n, fn, mode, thread_count
+ * Output arg:  status:  what the cache did, for printing
+ * Return val:  estimate of integral from a to b of f(x)
+ */
+double Cached_trap(const char* dir, double a, double b, long n,
+      const integrand_t* fn, int mode, int thread_count, char* status) {
+   trap_cache_t cache;
+   double part_sum[CACHE_PARTS];
+   long samples;
+   int level, k, found, last = Cache_level(n);
+
+   found = Cache_load(dir, fn, mode, a, b, n, &cache);
+   if (cache.level >= last) {
+      sprintf(status, "hit");
+      return Cache_estimate(&cache, fn, n);
+   }
+   if (found)
+      sprintf(status, "refined from n = %ld", cache.n_odd << cache.level);
+   else
+      sprintf(status, "new entry");
+
+   for (level = cache.level + 1; level <= last; level++) {
+      samples = Cache_new_samples(&cache, level);
+      for (k = 0; k < CACHE_PARTS; k++)
+         part_sum[k] = 0.0;
+#     pragma omp parallel num_threads(thread_count) default(none) \
+         shared(cache, fn, level, samples) reduction(+: part_sum)
+      {
+         part_t mine = Partition(samples, omp_get_thread_num(),
+               omp_get_num_threads(), PART_ALIGN);
+
+         Cache_range_sums(&cache, fn, level, mine.first, mine.count,
+               part_sum);
+      }
+      Cache_add_level(&cache, fn, level, part_sum);
+   }
+   if (!Cache_save(dir, &cache))
+      fprintf(stderr, "Can't write the cache entry in %s\n", dir);
+
+   return Cache_estimate(&cache, fn, n);
+}  /* Cached_trap */
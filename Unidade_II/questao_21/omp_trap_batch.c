@@ -0,0 +1,279 @@
+/* File:    omp_trap_batch.c
+ * Purpose: Estimate many definite integrals with the trapezoidal
+ *          rule, using one team of threads for all of them.
+ *
+ * Input:   One job per line:  a b n [integrand]
+ *          (blank lines and lines starting with # are skipped)
+ * Output:  One line per job, in the order of the input:
+ *          job number, a, b, n, integrand and the estimate of the
+ *          integral (or "error" if the line couldn't be read).
+ *          The number of jobs and the time go to stderr.
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_trap_batch omp_trap_batch.c -lm
+ * Usage:   ./omp_trap_batch <number of threads> [job file]
+ *          (without a job file the jobs are read from stdin;  jobs.txt
+ *          is a small sample)
+ *
+ * Notes:
+ *   1.  The parallel region is entered once.  Inside it one thread
+ *       reads up to BATCH_JOBS jobs and cuts them into pieces, the
+ *       team sums the pieces (schedule(dynamic)), and one thread
+ *       writes the results;  then the next batch is read.
+ *   2.  Pieces have about BATCH_CHUNK samples:  consecutive jobs with
+ *       fewer samples are packed into one piece, and jobs with more
+ *       are split into several (comum/partition.h).  The pieces of a
+ *       split job are added in order, so the results don't depend on
+ *       the number of threads.
+ *   3.  The integrands are those of comum/integrands.h (default x^2).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/partition.h"
+
+#define BATCH_JOBS  4096       /* Jobs read at a time        */
+#define BATCH_CHUNK (1L << 16) /* Samples per piece of work  */
+#define MAX_LINE    256
+
+typedef struct {
+   double a, b;
+   long   n;
+   const integrand_t* fn;   /* NULL if the line had an error  */
+   double result;
+   int    first_piece;      /* Pieces of a split job          */
+   int    piece_count;      /* 0 if the job is in a pack      */
+} batch_job_t;
+
+typedef struct {
+   int    job;     /* First job of the piece                        */
+   int    jobs;    /* > 0:  whole jobs job, ..., job+jobs-1         */
+                   /* = 0:  samples first..first+count-1 of job     */
+   long   first;
+   long   count;
+   double sum;
+} batch_piece_t;
+
+void Usage(char* prog_name);
+int  Read_jobs(FILE* in, batch_job_t jobs[], int max_jobs);
+int  Plan_pieces(batch_job_t jobs[], int job_count, batch_piece_t** pieces_p,
+      int* piece_cap_p);
+void Piece_sum(batch_piece_t* piece, batch_job_t jobs[]);
+double Trap(double a, double b, long n, const integrand_t* fn);
+void Write_results(FILE* out, batch_job_t jobs[], int job_count,
+      const batch_piece_t pieces[], long job_base);
+
+int main(int argc, char* argv[]) {
+   int     thread_count;
+   FILE*   in = stdin;
+   FILE*   out = stdout;
+   batch_job_t*   jobs;
+   batch_piece_t* pieces = NULL;
+   int     job_count = 0, piece_count = 0, piece_cap = 0;
+   long    total_jobs = 0;
+   double  start, finish;
+
+   if (argc < 2 || argc > 3) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count < 1) Usage(argv[0]);
+   if (argc == 3 && (in = fopen(argv[2], "r")) == NULL) {
+      fprintf(stderr, "Can't open %s\n", argv[2]);
+      Usage(argv[0]);
+   }
+   jobs = malloc(BATCH_JOBS*sizeof(batch_job_t));
+
+   start = omp_get_wtime();
+#  pragma omp parallel num_threads(thread_count) default(none) \
+      shared(in, out, jobs, pieces, job_count, piece_count, piece_cap, total_jobs)
+   for (;;) {
+      int p;
+
+#     pragma omp single
+      {
+         job_count = Read_jobs(in, jobs, BATCH_JOBS);
+         piece_count = Plan_pieces(jobs, job_count, &pieces, &piece_cap);
+      }
+      if (job_count == 0) break;
+
+#     pragma omp for schedule(dynamic)
+      for (p = 0; p < piece_count; p++)
+         Piece_sum(&pieces[p], jobs);
+
+#     pragma omp single
+      {
+         Write_results(out, jobs, job_count, pieces, total_jobs);
+         total_jobs += job_count;
+      }
+   }
+   finish = omp_get_wtime();
+
+   fprintf(stderr, "%ld jobs, %d threads, processing time: %f\n",
+         total_jobs, thread_count, finish - start);
+
+   if (in != stdin) fclose(in);
+   free(pieces);
+   free(jobs);
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> [job file]\n", prog_name);
+   fprintf(stderr, "   each line of input:  a b n [integrand]\n");
+   Integrand_list(stderr);
+   exit(0);
+}  /* Usage */
+
+/*--------------------------------------------------------------------
+ * Function:    Read_jobs
+ * Purpose:     Read up to max_jobs jobs
+ * In arg:      in, max_jobs
+ * Out arg:     jobs
+ * Return val:  number of jobs read (0 at the end of the input)
+ */
+int Read_jobs(FILE* in, batch_job_t jobs[], int max_jobs) {
+   char line[MAX_LINE], name[MAX_LINE];
+   int  count = 0, fields;
+   batch_job_t* job;
+
+   while (count < max_jobs && fgets(line, MAX_LINE, in) != NULL) {
+      if (strspn(line, " \t\r\n") == strlen(line) || line[0] == '#')
+         continue;
+      job = &jobs[count++];
+      job->piece_count = 0;
+      fields = sscanf(line, "%lf %lf %ld %255s", &job->a, &job->b,
+            &job->n, name);
+      job->fn = (fields >= 3 && job->n >= 1)
+         ? Integrand_find(fields == 4 ? name : NULL) : NULL;
+   }
+
+   return count;
+}  /* Read_jobs */
+
+/*--------------------------------------------------------------------
+ * Function:    Plan_pieces
+ * Purpose:     Cut the jobs into pieces of about BATCH_CHUNK samples
+ * In args:     jobs, job_count
+ * In/out args: pieces_p, piece_cap_p:  array of pieces and its size
+ *              (grown as needed)
+ * Out arg:     jobs[].first_piece, jobs[].piece_count
+ * Return val:  number of pieces
+ */
+int Plan_pieces(batch_job_t jobs[], int job_count,
+      batch_piece_t** pieces_p, int* piece_cap_p) {
+   int  j, k, count = 0, split;
+   long pack_samples = 0, interior;
+   batch_piece_t* piece;
+   part_t part;
+
+   for (j = 0; j < job_count; j++) {
+      if (jobs[j].fn == NULL) continue;
+      interior = jobs[j].n - 1;
+      split = (interior > BATCH_CHUNK)
+         ? (int) ((interior + BATCH_CHUNK - 1)/BATCH_CHUNK) : 0;
+
+      if (count + (split > 0 ? split : 1) > *piece_cap_p) {
+         *piece_cap_p = 2*(*piece_cap_p) + split + BATCH_JOBS;
+         *pieces_p = realloc(*pieces_p, *piece_cap_p*sizeof(batch_piece_t));
+      }
+
+      if (split == 0) {
+         /* Add to the open pack, or start a new one */
+         piece = (count > 0) ? &(*pieces_p)[count-1] : NULL;
+         if (piece != NULL && piece->jobs > 0
+               && piece->job + piece->jobs == j
+               && pack_samples + jobs[j].n <= BATCH_CHUNK) {
+            piece->jobs++;
+            pack_samples += jobs[j].n;
+         } else {
+            piece = &(*pieces_p)[count++];
+            piece->job = j;
+            piece->jobs = 1;
+            pack_samples = jobs[j].n;
+         }
+         continue;
+      }
+
+      /* Split the interior samples 1..n-1 */
+      jobs[j].first_piece = count;
+      jobs[j].piece_count = split;
+      for (k = 0; k < split; k++) {
+         part = Partition(interior, k, split, PART_ALIGN);
+         piece = &(*pieces_p)[count++];
+         piece->job = j;
+         piece->jobs = 0;
+         piece->first = 1 + part.first;
+         piece->count = part.count;
+      }
+   }
+
+   return count;
+}  /* Plan_pieces */
+
+/*--------------------------------------------------------------------
+ * Function:    Piece_sum
+ * Purpose:     Do the work of one piece:  the results of the jobs of
+ *              a pack, or the sum of the samples of a slice of a job
+ */
+void Piece_sum(batch_piece_t* piece, batch_job_t jobs[]) {
+   batch_job_t* job = &jobs[piece->job];
+   int j;
+
+   if (piece->jobs > 0) {
+      for (j = 0; j < piece->jobs; j++)
+         job[j].result = Trap(job[j].a, job[j].b, job[j].n, job[j].fn);
+   } else {
+      piece->sum = job->fn->trap_sum(job->a, (job->b - job->a)/job->n,
+            piece->first, piece->count);
+   }
+}  /* Piece_sum */
+
+/*------------------------------------------------------------------
+ * Function:    Trap
+ * Purpose:     Serial trapezoidal rule
+ * Return val:  estimate of integral from a to b of f(x)
+ */
+double Trap(double a, double b, long n, const integrand_t* fn) {
+   double h = (b-a)/n, approx;
+
+   approx = (fn->f(a) + fn->f(b))/2.0;
+   approx += fn->trap_sum(a, h, 1, n-1);
+   return h*approx;
+}  /* Trap */
+
+/*--------------------------------------------------------------------
+ * Function:    Write_results
+ * Purpose:     Finish the split jobs and print the results of a batch
+ *              in job order
+ * In args:     jobs, job_count, pieces
+ *              job_base:  number of jobs in the earlier batches
+ */
+void Write_results(FILE* out, batch_job_t jobs[], int job_count,
+      const batch_piece_t pieces[], long job_base) {
+   batch_job_t* job;
+   double sum;
+   int j, k;
+
+   for (j = 0; j < job_count; j++) {
+      job = &jobs[j];
+      if (job->fn == NULL) {
+         fprintf(out, "%ld error\n", job_base + j);
+         continue;
+      }
+      if (job->piece_count > 0) {
+         sum = (job->fn->f(job->a) + job->fn->f(job->b))/2.0;
+         for (k = 0; k < job->piece_count; k++)
+            sum += pieces[job->first_piece + k].sum;
+         job->result = sum*(job->b - job->a)/job->n;
+      }
+      fprintf(out, "%ld %f %f %ld %s %.15e\n", job_base + j, job->a,
+            job->b, job->n, job->fn->name, job->result);
+   }
+}  /* Write_results */
@@ -0,0 +1,345 @@
+/* File:    omp_trap_server.c
+ * Purpose: Resident version of the trapezoidal rule programs:  it
+ *          keeps one team of threads alive and answers integration
+ *          requests sent to a Unix domain socket, so the callers
+ *          don't pay for process start and OpenMP initialization on
+ *          every integral.
+ *
+ * Input:   Lines sent by the clients to the socket:
+ *             a b n [integrand]   integrate, answer "<estimate>"
+ *             stats               answer the latency percentiles
+ *             quit                stop the server
+ *          Bad requests are answered "error <reason>".
+ * Output:  One line per request, to the client that sent it.  The
+ *          latency percentiles are also printed to stderr when the
+ *          server stops.
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_trap_server omp_trap_server.c -lm
+ * Usage:   ./omp_trap_server <number of threads> <socket path>
+ *          e.g.  echo "0 3 1000 sin" | nc -U -q1 /tmp/trap.sock
+ *
+ * Notes:
+ *   1.  The parallel region is entered once.  The master thread
+ *       waits for requests (poll) while the other threads wait at a
+ *       barrier.  Requests with n <= SERVER_SMALL_N are answered by
+ *       the master alone, without waking the team;  larger ones are
+ *       split among the threads (comum/partition.h) and the partial
+ *       sums are added in thread order.
+ *   2.  The latency of a request is the time from reading its line
+ *       to writing its answer.  The last LAT_WINDOW latencies are
+ *       kept for the percentiles.
+ *   3.  Up to MAX_CLIENTS clients can be connected at a time;  their
+ *       requests are answered in the order they are read.
+ *   4.  Set OMP_WAIT_POLICY=active to keep the idle threads
+ *       spinning:  this lowers the latency of large requests, at
+ *       the cost of busy cores.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "../../comum/integrands.h"
+#include "../../comum/partition.h"
+
+#define MAX_CLIENTS     64
+#define MAX_LINE        256
+#define LAT_WINDOW      65536
+#define SERVER_SMALL_N  (1L << 15)
+
+typedef struct {
+   int   fd;
+   int   len;              /* Bytes in buf  */
+   char  buf[MAX_LINE];
+} client_t;
+
+typedef struct {
+   int      listen_fd;
+   int      client_count;
+   client_t clients[MAX_CLIENTS];
+   double   latency[LAT_WINDOW];   /* Ring of latencies, in seconds */
+   long     requests;
+} server_t;
+
+typedef struct {
+   int    fd;          /* Client to answer                  */
+   double a, b;
+   long   n;
+   const integrand_t* fn;
+   double received;    /* omp_get_wtime() when it was read  */
+} request_t;
+
+enum {REQ_DONE, REQ_TEAM, REQ_QUIT};
+
+void Usage(char* prog_name);
+int  Open_socket(const char* path);
+int  Next_request(server_t* server, request_t* req);
+int  Handle_line(server_t* server, int fd, char* line, request_t* req);
+double Trap(double a, double b, long n, const integrand_t* fn);
+void Reply(server_t* server, const request_t* req, double estimate);
+void Latency_stats(const server_t* server, char* text, int size);
+
+int main(int argc, char* argv[]) {
+   int       thread_count, status = REQ_DONE;
+   server_t* server;
+   request_t req;
+   double*   partial;   /* Each thread's sum */
+   char      text[MAX_LINE];
+
+   if (argc != 3) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count < 1) Usage(argv[0]);
+
+   server = calloc(1, sizeof(server_t));
+   server->listen_fd = Open_socket(argv[2]);
+   if (server->listen_fd < 0) {
+      perror(argv[2]);
+      exit(1);
+   }
+   signal(SIGPIPE, SIG_IGN);
+   partial = malloc(thread_count*sizeof(double));
+   fprintf(stderr, "Listening on %s with %d threads\n", argv[2],
+         thread_count);
+
+#  pragma omp parallel num_threads(thread_count) default(none) \
+      shared(server, req, status, partial)
+   for (;;) {
+      int my_rank = omp_get_thread_num();
+      int threads = omp_get_num_threads();
+      part_t part;
+
+#     pragma omp master
+      status = Next_request(server, &req);
+#     pragma omp barrier
+      if (status == REQ_QUIT) break;
+
+      /* Interior samples 1..n-1 */
+      part = Partition(req.n - 1, my_rank, threads, PART_ALIGN);
+      partial[my_rank] = req.fn->trap_sum(req.a, (req.b - req.a)/req.n,
+            1 + part.first, part.count);
+#     pragma omp barrier
+
+#     pragma omp master
+      {
+         double sum = (req.fn->f(req.a) + req.fn->f(req.b))/2.0;
+         int t;
+
+         for (t = 0; t < threads; t++)
+            sum += partial[t];
+         Reply(server, &req, sum*(req.b - req.a)/req.n);
+      }
+   }
+
+   Latency_stats(server, text, MAX_LINE);
+   fprintf(stderr, "%s", text);
+
+   close(server->listen_fd);
+   unlink(argv[2]);
+   free(partial);
+   free(server);
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> <socket path>\n",
+         prog_name);
+   fprintf(stderr, "   requests:  a b n [integrand] | stats | quit\n");
+   Integrand_list(stderr);
+   exit(0);
+}  /* Usage */
+
+/*--------------------------------------------------------------------
+ * Function:    Open_socket
+ * Purpose:     Create a Unix domain socket listening at path
+ * Return val:  its file descriptor, or -1 on error
+ */
+int Open_socket(const char* path) {
+   struct sockaddr_un addr;
+   int fd;
+
+   if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+   unlink(path);
+
+   fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd < 0) return -1;
+   if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0
+         || listen(fd, MAX_CLIENTS) < 0) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}  /* Open_socket */
+
+/*--------------------------------------------------------------------
+ * Function:    Next_request
+ * Purpose:     Serve the clients until a request needs the whole
+ *              team or a client asks the server to quit
+ * In/out arg:  server
+ * Out arg:     req:  the request for the team
+ * Return val:  REQ_TEAM or REQ_QUIT
+ */
+int Next_request(server_t* server, request_t* req) {
+   struct pollfd fds[MAX_CLIENTS + 1];
+   client_t* client;
+   char* newline;
+   int c, status, got, line_len;
+
+   for (;;) {
+      /* Complete lines already read */
+      for (c = 0; c < server->client_count; c++) {
+         client = &server->clients[c];
+         while ((newline = memchr(client->buf, '\n', client->len))
+               != NULL) {
+            *newline = '\0';
+            line_len = newline - client->buf + 1;
+            status = Handle_line(server, client->fd, client->buf, req);
+            client->len -= line_len;
+            memmove(client->buf, client->buf + line_len, client->len);
+            if (status != REQ_DONE) return status;
+         }
+         if (client->len == MAX_LINE) {
+            dprintf(client->fd, "error line too long\n");
+            client->len = 0;
+         }
+      }
+
+      /* Wait for more */
+      fds[0].fd = server->listen_fd;
+      fds[0].events = POLLIN;
+      for (c = 0; c < server->client_count; c++) {
+         fds[c+1].fd = server->clients[c].fd;
+         fds[c+1].events = POLLIN;
+      }
+      if (poll(fds, server->client_count + 1, -1) < 0) continue;
+
+      for (c = server->client_count - 1; c >= 0; c--) {
+         if (fds[c+1].revents == 0) continue;
+         client = &server->clients[c];
+         got = read(client->fd, client->buf + client->len,
+               MAX_LINE - client->len);
+         if (got > 0) {
+            client->len += got;
+         } else {
+            close(client->fd);
+            *client = server->clients[--server->client_count];
+         }
+      }
+      if ((fds[0].revents & POLLIN)
+            && server->client_count < MAX_CLIENTS) {
+         client = &server->clients[server->client_count];
+         client->fd = accept(server->listen_fd, NULL, NULL);
+         client->len = 0;
+         if (client->fd >= 0) server->client_count++;
+      }
+   }
+}  /* Next_request */
+
+/*--------------------------------------------------------------------
+ * Function:    Handle_line
+ * Purpose:     Answer one request, unless it needs the team
+ * In args:     fd:  the client that sent it
+ *              line
+ * In/out arg:  server
+ * Out arg:     req:  filled in for REQ_TEAM
+ * Return val:  REQ_DONE, REQ_TEAM or REQ_QUIT
+ */
+int Handle_line(server_t* server, int fd, char* line, request_t* req) {
+   char name[MAX_LINE], text[MAX_LINE];
+   int fields;
+
+   req->received = omp_get_wtime();
+   req->fd = fd;
+   if (sscanf(line, "%255s", name) != 1) return REQ_DONE;
+   if (strcmp(name, "quit") == 0) return REQ_QUIT;
+   if (strcmp(name, "stats") == 0) {
+      Latency_stats(server, text, MAX_LINE);
+      dprintf(fd, "%s", text);
+      return REQ_DONE;
+   }
+
+   fields = sscanf(line, "%lf %lf %ld %255s", &req->a, &req->b, &req->n,
+         name);
+   if (fields < 3 || req->n < 1) {
+      dprintf(fd, "error expected: a b n [integrand]\n");
+      return REQ_DONE;
+   }
+   req->fn = Integrand_find(fields == 4 ? name : NULL);
+   if (req->fn == NULL) {
+      dprintf(fd, "error unknown integrand %s\n", name);
+      return REQ_DONE;
+   }
+
+   if (req->n > SERVER_SMALL_N) return REQ_TEAM;
+   Reply(server, req, Trap(req->a, req->b, req->n, req->fn));
+   return REQ_DONE;
+}  /* Handle_line */
+
+/*------------------------------------------------------------------
+ * Function:    Trap
+ * Purpose:     Serial trapezoidal rule, for the small requests
+ * Return val:  estimate of integral from a to b of f(x)
+ */
+double Trap(double a, double b, long n, const integrand_t* fn) {
+   double h = (b-a)/n, approx;
+
+   approx = (fn->f(a) + fn->f(b))/2.0;
+   approx += fn->trap_sum(a, h, 1, n-1);
+   return h*approx;
+}  /* Trap */
+
+/*--------------------------------------------------------------------
+ * Function:    Reply
+ * Purpose:     Send the estimate to the client and record the latency
+ *              of the request
+ */
+void Reply(server_t* server, const request_t* req, double estimate) {
+   dprintf(req->fd, "%.15e\n", estimate);
+   server->latency[server->requests % LAT_WINDOW] =
+      omp_get_wtime() - req->received;
+   server->requests++;
+}  /* Reply */
+
+static int Compare_doubles(const void* x, const void* y) {
+   double a = *(const double*) x, b = *(const double*) y;
+
+   return (a > b) - (a < b);
+}  /* Compare_doubles */
+
+/*--------------------------------------------------------------------
+ * Function:    Latency_stats
+ * Purpose:     Format the percentiles of the latencies of the last
+ *              LAT_WINDOW requests, in microseconds
+ * In arg:      server
+ * Out arg:     text:  one line
+ */
+void Latency_stats(const server_t* server, char* text, int size) {
+   static double sorted[LAT_WINDOW];
+   long count = server->requests < LAT_WINDOW
+      ? server->requests : LAT_WINDOW;
+
+   if (count == 0) {
+      snprintf(text, size, "requests 0\n");
+      return;
+   }
+   memcpy(sorted, server->latency, count*sizeof(double));
+   qsort(sorted, count, sizeof(double), Compare_doubles);
+   snprintf(text, size, "requests %ld p50 %.1f p90 %.1f p99 %.1f "
+         "p99.9 %.1f max %.1f us\n", server->requests,
+         1.0e6*sorted[count*50/100], 1.0e6*sorted[count*90/100],
+         1.0e6*sorted[count*99/100], 1.0e6*sorted[count*999/1000],
+         1.0e6*sorted[count-1]);
+}  /* Latency_stats */
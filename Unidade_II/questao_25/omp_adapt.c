@@ -0,0 +1,236 @@
+/* File:    omp_adapt.c
+ * Purpose: Estimate definite integral (or area under curve) using an
+ *          adaptive Gauss-Kronrod rule.  Intervals whose error
+ *          estimate is too large are split in two, and the halves are
+ *          integrated by OpenMP tasks.
+ *
+ * Input:   a, b, tol
+ * Output:  estimate of integral from a to b of f(x), its estimated
+ *          and (when the primitive is known) actual error, and the
+ *          number of evaluations of f used.
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_adapt omp_adapt.c -lm
+ * Usage:   ./omp_adapt <number of threads> [integrand]
+ *
+ * Notes:
+ *   1.  The function f(x) is chosen on the command line from the
+ *       library in comum/integrands.h (default x^2).
+ *   2.  Each interval is integrated with the 7-point Gauss rule and
+ *       the 15-point Kronrod rule that extends it; the difference
+ *       between them is the error estimate.  An interval with error
+ *       estimate above its share of tol (tol*(length of interval)/
+ *       (b-a)) is split at its midpoint.
+ *   3.  The two halves become tasks, which idle threads take from
+ *       the runtime's task queues, so steep regions that need many
+ *       levels of splitting are shared by the whole team.  Below
+ *       TASK_DEPTH levels the recursion continues in the same task,
+ *       so the tasks don't get too small.
+ *   4.  Compare with omp_trap3:  for peaked integrands (e.g. "peak")
+ *       this uses orders of magnitude fewer evaluations of f for the
+ *       same accuracy.
+ *   5.  An interval isn't split once its error estimate is at the
+ *       rounding level of its result (ROUNDING_ERR), since the halves
+ *       can't do better;  so tol = 0 asks for the best accuracy the
+ *       rule can give.  In all, at most about MAX_EVALS evaluations
+ *       are used:  if that stops the splitting before tol is met, a
+ *       warning is printed.
+ *   6.  If a > b the result is minus the integral from b to a.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <omp.h>
+#include "../../comum/integrands.h"
+
+#define MAX_DEPTH  50  /* Intervals are never split further than this */
+#define TASK_DEPTH 12  /* Deeper levels run inside the parent's task  */
+#define MAX_EVALS  15000000L      /* About 10^6 intervals in all      */
+#define ROUNDING_ERR (50*DBL_EPSILON)  /* Relative error we can't beat */
+
+static long adapt_evals = 0;   /* Evaluations so far, by every task   */
+static int  adapt_capped = 0;  /* 1 if MAX_EVALS stopped a split      */
+
+void Usage(char* prog_name);
+double Gauss_kronrod(double a, double b, const integrand_t* fn,
+      double* err_p);
+double Adapt(double a, double b, double tol, int depth,
+      const integrand_t* fn, double* err_p, long* evals_p);
+
+int main(int argc, char* argv[]) {
+   double  global_result = 0.0;  /* Store result in global_result */
+   double  global_err = 0.0;     /* Estimated error of the result */
+   double  a, b;                 /* Left and right endpoints      */
+   double  tol;                  /* Requested absolute error      */
+   long    evals = 0;            /* Number of evaluations of f    */
+   int     thread_count;
+   const integrand_t* fn;        /* Function we're integrating    */
+   double  start, finish;
+   double  lo, hi, sign = 1.0;   /* Interval actually integrated  */
+
+   if (argc < 2 || argc > 3) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc == 3 ? argv[2] : NULL);
+   if (fn == NULL) Usage(argv[0]);
+   printf("Enter a, b, and tol\n");
+   scanf("%lf %lf %lf", &a, &b, &tol);
+   lo = a;
+   hi = b;
+   if (a > b) {
+      lo = b;
+      hi = a;
+      sign = -1.0;
+   }
+
+   start = omp_get_wtime();
+#  pragma omp parallel num_threads(thread_count)
+#  pragma omp single
+   global_result = sign*Adapt(lo, hi, tol, 0, fn, &global_err, &evals);
+   finish = omp_get_wtime();
+
+   printf("f(x) = %s\n", fn->formula);
+   printf("With %ld evaluations of f, our estimate\n", evals);
+   printf("of the integral from %f to %f = %.14e\n",
+      a, b, global_result);
+   printf("Estimated error = %.2e\n", global_err);
+   if (adapt_capped)
+      printf("Warning: stopped after about %ld evaluations, "
+            "before the error reached tol\n", MAX_EVALS);
+   if (fn->primitive != NULL)
+      printf("Actual error    = %.2e\n",
+            fabs(global_result - Integrand_exact(fn, a, b)));
+   printf("Processing time: %f \n", finish - start);
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> [integrand]\n", prog_name);
+   Integrand_list(stderr);
+   exit(0);
+}  /* Usage */
+
+/*------------------------------------------------------------------
+ * Function:    Gauss_kronrod
+ * Purpose:     Apply the 15-point Kronrod rule to [a, b] and use the
+ *              embedded 7-point Gauss rule to estimate its error
+ * Input args:
+ *    a: left endpoint
+ *    b: right endpoint
+ *    fn: function we're integrating
+ * Output arg:
+ *    err_p:  estimate of the error (|K15 - G7|)
+ * Return val:  K15 estimate of integral from a to b of f(x)
+ */
+double Gauss_kronrod(double a, double b, const integrand_t* fn,
+      double* err_p) {
+   /* Non-negative Kronrod abscissae of the symmetric rule on
+    * [-1, 1], largest first:  odd indices are the Gauss nodes */
+   static const double xk[8] = {
+      0.991455371120812639206854697526329,
+      0.949107912342758524526189684047851,
+      0.864864423359769072789712788640926,
+      0.741531185599394439863864773280788,
+      0.586087235467691130294144845693013,
+      0.405845151377397166906606412076961,
+      0.207784955007898467600689403773245,
+      0.000000000000000000000000000000000};
+   static const double wk[8] = {
+      0.022935322010529224963732008058970,
+      0.063092092629978553290700663189204,
+      0.104790010322250183839876322541518,
+      0.140653259715525918745189590510238,
+      0.169004726639267902826583426598550,
+      0.190350578064785409913256402421014,
+      0.204432940075298892414161999234649,
+      0.209482141084727828012999174891714};
+   static const double wg[4] = {
+      0.129484966168869693270611432679082,
+      0.279705391489276667901467771423780,
+      0.381830050505118944950369775488975,
+      0.417959183673469387755102040816327};
+   double x[15], y[15];
+   double center = (a + b)/2.0, half = (b - a)/2.0;
+   double kronrod, gauss;
+   int j;
+
+   for (j = 0; j < 7; j++) {
+      x[j]    = center - half*xk[j];
+      x[14-j] = center + half*xk[j];
+   }
+   x[7] = center;
+   fn->f_batch(x, y, 15);
+
+   kronrod = wk[7]*y[7];
+   gauss   = wg[3]*y[7];
+   for (j = 0; j < 7; j++) {
+      kronrod += wk[j]*(y[j] + y[14-j]);
+      if (j % 2 == 1)
+         gauss += wg[j/2]*(y[j] + y[14-j]);
+   }
+   kronrod *= half;
+   gauss   *= half;
+
+   *err_p = fabs(kronrod - gauss);
+   return kronrod;
+}  /* Gauss_kronrod */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt
+ * Purpose:     Integrate f over [a, b] to within tol, splitting the
+ *              interval (into tasks) where needed
+ * Input args:
+ *    a: left endpoint
+ *    b: right endpoint
+ *    tol: error allowed on [a, b]
+ *    depth: number of splits that led to [a, b]
+ *    fn: function we're integrating
+ * Output args:
+ *    err_p:  estimated error of the result
+ *    evals_p:  evaluations of f are added to *evals_p
+ * Return val:  estimate of integral from a to b of f(x)
+ *
+ * Note:        Must be called by one thread of a parallel region
+ *              (e.g. inside a single directive).  [a, b] isn't split
+ *              if its error is at the rounding level of the result or
+ *              if the MAX_EVALS evaluations are used up (see note 5).
+ */
+double Adapt(double a, double b, double tol, int depth,
+      const integrand_t* fn, double* err_p, long* evals_p) {
+   double  result, err;
+   double  left, right, left_err, right_err, mid;
+   long    left_evals = 0, right_evals = 0, all_evals;
+
+   result = Gauss_kronrod(a, b, fn, &err);
+   *evals_p += 15;
+#  pragma omp atomic capture
+   all_evals = adapt_evals += 15;
+   mid = (a + b)/2.0;
+   if (err <= tol || err <= ROUNDING_ERR*fabs(result)
+         || depth >= MAX_DEPTH || mid <= a || mid >= b) {
+      *err_p = err;
+      return result;
+   }
+   if (all_evals >= MAX_EVALS) {
+#     pragma omp atomic write
+      adapt_capped = 1;
+      *err_p = err;
+      return result;
+   }
+
+#  pragma omp task shared(left, left_err, left_evals) \
+      if (depth < TASK_DEPTH)
+   left = Adapt(a, mid, tol/2.0, depth+1, fn, &left_err, &left_evals);
+   right = Adapt(mid, b, tol/2.0, depth+1, fn, &right_err, &right_evals);
+#  pragma omp taskwait
+
+   *evals_p += left_evals + right_evals;
+   *err_p = left_err + right_err;
+   return left + right;
+}  /* Adapt */
@@ -6,12 +6,15 @@
  * Output:  estimate of integral from a to b of f(x)
  *          using n trapezoids.
  *
- * Compile: gcc -g -Wall -fopenmp -o omp_trap3 omp_trap3.c
+ * Compile: gcc -g -Wall -fopenmp -o omp_trap3 omp_trap3.c -lm
  * Usage:   $env:OMP_SCHEDULE="<type>"
- *          ./omp_trap3 <number of threads>
+ *          ./omp_trap3 <number of threads> [integrand]
  *
  * Notes:   
- *   1.  The function f(x) is hardwired.
+ *   1.  The function f(x) is chosen on the command line from the
+ *       library in comum/integrands.h (default x^2).  Since the
+ *       loop below prints every iteration, it just calls fn->f
+ *       for each sample.
  *   2.  In this version, it's not necessary for n to be
  *       evenly divisible by thread_count.
  *
@@ -22,24 +25,29 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h>
+#include "../../comum/integrands.h"
 
 void Usage(char* prog_name);
-double f(double x);    /* Function we're integrating */
-double Trap(double a, double b, int n, int thread_count);
+double Trap(double a, double b, int n, const integrand_t* fn,
+      int thread_count);
 
 int main(int argc, char* argv[]) {
    double  global_result = 0.0;  /* Store result in global_result */
    double  a, b;                 /* Left and right endpoints      */
    int     n;                    /* Total number of trapezoids    */
    int     thread_count;
+   const integrand_t* fn;        /* Function we're integrating    */
 
-   if (argc != 2) Usage(argv[0]);
+   if (argc < 2 || argc > 3) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
+   fn = Integrand_find(argc == 3 ? argv[2] : NULL);
+   if (fn == NULL) Usage(argv[0]);
    printf("Enter a, b, and n\n");
    scanf("%lf %lf %d", &a, &b, &n);
 
-   global_result = Trap(a, b, n, thread_count);
+   global_result = Trap(a, b, n, fn, thread_count);
 
+   printf("f(x) = %s\n", fn->formula);
    printf("With n = %d trapezoids, our estimate\n", n);
    printf("of the integral from %f to %f = %.14e\n",
       a, b, global_result);
@@ -53,23 +61,11 @@ int main(int argc, char* argv[]) {
  */
 void Usage(char* prog_name) {
 
-   fprintf(stderr, "usage: %s <number of threads>\n", prog_name);
+   fprintf(stderr, "usage: %s <number of threads> [integrand]\n", prog_name);
+   Integrand_list(stderr);
    exit(0);
 }  /* Usage */
 
-/*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input arg:   x
- * Return val:  f(x)
- */
-double f(double x) {
-   double return_val;
-
-   return_val = x*x;
-   return return_val;
-}  /* f */
-
 /*------------------------------------------------------------------
  * Function:    Trap
  * Purpose:     Use trapezoidal rule to estimate definite integral
@@ -77,10 +73,12 @@ double f(double x) {
  *    a: left endpoint
  *    b: right endpoint
  *    n: number of trapezoids
+ *    fn: function we're integrating
  * Return val:
  *    approx:  estimate of integral from a to b of f(x)
  */
-double Trap(double a, double b, int n, int thread_count) {
+double Trap(double a, double b, int n, const integrand_t* fn,
+      int thread_count) {
    double  h, approx;
    int  i;
    int *thread_number;
@@ -88,11 +86,11 @@ double Trap(double a, double b, int n, int thread_count) {
    thread_number = (int *)malloc(sizeof(int) * n);
 
    h = (b-a)/n; 
-   approx = (f(a) + f(b))/2.0; 
+   approx = (fn->f(a) + fn->f(b))/2.0; 
 #  pragma omp parallel for num_threads(thread_count) \
       reduction(+: approx) schedule(runtime)
    for (i = 1; i <= n-1; i++){
-     approx += f(a + i*h);
+     approx += fn->f(a + i*h);
      thread_number[i-1] = omp_get_thread_num();
      printf("Thread number: %d - Iteration: %d \n", thread_number[i-1], i);
    }
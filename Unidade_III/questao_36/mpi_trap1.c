@@ -7,8 +7,8 @@
  * Output:   Estimate of the integral from a to b of f(x)
  *           using the trapezoidal rule and n trapezoids.
  *
- * Compile:  mpicc -g -Wall -o mpi_trap1 mpi_trap1.c
- * Run:      mpiexec -n <number of processes> ./mpi_trap1
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap1 mpi_trap1.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_trap1 [integrand]
  *
  * Algorithm:
  *    1.  Each process calculates "its" interval of
@@ -19,7 +19,8 @@
  *    3b. Process 0 sums the calculations received from
  *        the individual processes and prints the result.
  *
- * Note:  f(x), a, b, and n are all hardwired.
+ * Note:  a, b, and n are all hardwired.  f(x) is chosen on the
+ *        command line from comum/integrands.h (default x^2).
  *
  * IPP:   Section 3.2.2 (pp. 96 and ff.)
  */
@@ -27,19 +28,21 @@
 
 /* We'll be using MPI routines, definitions, etc. */
 #include <mpi.h>
+#include "../../comum/integrands.h"
+#include "../../comum/partition.h"
 
 /* Calculate local integral  */
-double Trap(double left_endpt, double right_endpt, int trap_count, 
-   double base_len);    
+double Trap(double left_endpt, double right_endpt, long trap_count, 
+   double base_len, const integrand_t* fn);    
 
-/* Function we're integrating */
-double f(double x); 
-
-int main(void) {
-   int my_rank, comm_sz, n = 1024, local_n, resto;   
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz;
+   long n = 1024;
+   part_t part;
    double a = 0.0, b = 3.0, h, local_a, local_b;
-   double local_int, total_int;
+   double local_int, total_int = 0.0;
    int source; 
+   const integrand_t* fn;   /* Function we're integrating */
 
    /* Let the system do what it needs to start up MPI */
    MPI_Init(NULL, NULL);
@@ -50,29 +53,25 @@ int main(void) {
    /* Find out how many processes are being used */
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
 
-   h = (b-a)/n;          /* h is the same for all processes */
-   local_n = n/comm_sz;  /* So is the number of trapezoids  */
-
-   /* Length of each process' interval of
-    * integration = local_n*h.  So my interval
-    * starts at: */
-   
-   resto = n%comm_sz;
-   if (resto == 0){
-      local_a = a + my_rank*local_n*h;
-      local_b = local_a + local_n*h;
-   }else{
-      if(my_rank < resto){
-      local_n += 1;
-      local_a = a + my_rank*local_n*h;
-      local_b = local_a + local_n*h;
-      }else{
-      local_a = a + my_rank*local_n*h + resto*h;
-      local_b = local_a + local_n*h; 
+   fn = Integrand_find(argc > 1 ? argv[1] : NULL);
+   if (fn == NULL) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand]\n", argv[0]);
+         Integrand_list(stderr);
       }
+      MPI_Finalize();
+      return 0;
    }
+
+   h = (b-a)/n;          /* h is the same for all processes */
+
+   /* My block of trapezoids:  the first processes get the
+    * remainder of n/comm_sz (see comum/partition.h) */
+   part = Partition(n, my_rank, comm_sz, PART_ALIGN);
+   local_a = Part_left(a, h, part);
+   local_b = Part_right(a, h, part);
    
-   local_int = Trap(local_a, local_b, local_n, h);
+   local_int = Trap(local_a, local_b, part.count, h, fn);
 
    /* Add up the integrals calculated by each process */
    if (my_rank != 0) { 
@@ -89,7 +88,8 @@ int main(void) {
 
    /* Print the result */
    if (my_rank == 0) {
-      printf("With n = %d trapezoids, our estimate\n", n);
+      printf("f(x) = %s\n", fn->formula);
+      printf("With n = %ld trapezoids, our estimate\n", n);
       printf("of the integral from %f to %f = %.15e\n",
           a, b, total_int);
    }
@@ -109,6 +109,7 @@ int main(void) {
  *               right_endpt
  *               trap_count 
  *               base_len
+ *               fn
  * Return val:   Trapezoidal rule estimate of integral from
  *               left_endpt to right_endpt using trap_count
  *               trapezoids
@@ -116,27 +117,15 @@ int main(void) {
 double Trap(
       double left_endpt  /* in */, 
       double right_endpt /* in */, 
-      int    trap_count  /* in */, 
-      double base_len    /* in */) {
-   double estimate, x; 
-   int i;
-
-   estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
+      long   trap_count  /* in */, 
+      double base_len    /* in */,
+      const integrand_t* fn /* in */) {
+   double estimate; 
+
+   if (trap_count <= 0) return 0.0;
+   estimate = (fn->f(left_endpt) + fn->f(right_endpt))/2.0;
+   estimate += fn->trap_sum(left_endpt, base_len, 1, trap_count-1);
    estimate = estimate*base_len;
 
    return estimate;
 } /*  Trap  */
-
-
-/*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input args:  x
- */
-double f(double x) {
-   return x*x;
-} /* f */
@@ -4,12 +4,13 @@
  *           interval and the number of trapezoids.
  *
  * Input:    The endpoints of the interval of integration and the number
- *           of trapezoids
+ *           of trapezoids, optionally followed (on the same line) by
+ *           the formula of f(x), e.g. "0 2 1000000 sin(x)*exp(-x*x)"
  * Output:   Estimate of the integral from a to b of f(x)
  *           using the trapezoidal rule and n trapezoids.
  *
- * Compile:  mpicc -g -Wall -o mpi_trap_46 mpi_trap_46.c
- * Run:      mpiexec -n <number of processes> ./mpi_trap_46
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap_46 mpi_trap_46.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_trap_46 [integrand]
  *
  * Algorithm:
  *    1.  Each process calculates "its" interval of
@@ -20,38 +21,65 @@
  *    3b. Process 0 sums the calculations received from
  *        the individual processes and prints the result.
  *
- * Note:  f(x) is all hardwired.
+ * Note:  f(x) is chosen on the command line from
+ *        comum/integrands.h (default x^2), unless a formula is given
+ *        in the input.  The formula is compiled on process 0 and
+ *        broadcast as bytecode (see comum/expr.h).  n can be any
+ *        (64-bit) number;  the trapezoids are split among the
+ *        processes by comum/partition.h.
  *
  * IPP:   Section 3.3.2  (pp. 100 and ff.)
  */
 #include <stdio.h>
 #include <mpi.h>
 #include <stdlib.h>
+#include "../../comum/integrands.h"
+#include "../../comum/expr.h"
+#include "../../comum/partition.h"
 
-void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p, int* n_p);
+void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p, long* n_p,
+      expr_prog_t* prog_p);
 
-double Trap(double left_endpt, double right_endpt, int trap_count, double base_len);    
+double Trap(double left_endpt, double right_endpt, long trap_count, double base_len,
+      const integrand_t* fn);    
 
-double f(double x); 
-
-int main(void) {
-   int my_rank, comm_sz, n, local_n;   
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz;
+   long n;
+   part_t part;
    double a, b, h, local_a, local_b;
-   double local_int, total_int;
+   double local_int, total_int = 0.0;
    int source; 
+   const integrand_t* fn;
+   expr_prog_t prog;
 
    MPI_Init(NULL, NULL);
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
 
-   Get_input(my_rank, comm_sz, &a, &b, &n);
+   fn = Integrand_find(argc > 1 ? argv[1] : NULL);
+   if (fn == NULL) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand]\n", argv[0]);
+         Integrand_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   Get_input(my_rank, comm_sz, &a, &b, &n, &prog);
+   if (prog.n_instr == EXPR_BAD_PROGRAM) {
+      MPI_Finalize();
+      return 0;
+   }
+   if (prog.n_instr != EXPR_NO_PROGRAM) fn = Expr_integrand(&prog);
 
    h = (b-a)/n;       
-   local_n = n/comm_sz; 
+   part = Partition(n, my_rank, comm_sz, PART_ALIGN);
 
-   local_a = a + my_rank*local_n*h;
-   local_b = local_a + local_n*h;
-   local_int = Trap(local_a, local_b, local_n, h);
+   local_a = Part_left(a, h, part);
+   local_b = Part_right(a, h, part);
+   local_int = Trap(local_a, local_b, part.count, h, fn);
 
    if (my_rank != 0)
       MPI_Send(&local_int, 1, MPI_DOUBLE, 0, 0, 
@@ -66,7 +94,8 @@ int main(void) {
    }
 
    if (my_rank == 0) {
-      printf("With n = %d trapezoids, our estimate\n", n);
+      printf("f(x) = %s\n", fn->formula);
+      printf("With n = %ld trapezoids, our estimate\n", n);
       printf("of the integral from %f to %f = %.15e\n",
           a, b, total_int);
    }
@@ -77,26 +106,30 @@ int main(void) {
 } /*  main  */
 
 //Get_input------------------------------------------------------------------
-void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p, int* n_p) {
+void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p, long* n_p,
+      expr_prog_t* prog_p) {
    int size_a, size_b, size_n, total_size;
    int position = 0;
    char* pack_buf;
+   char err[EXPR_MAX_TEXT];
 
    MPI_Pack_size(1, MPI_DOUBLE, MPI_COMM_WORLD, &size_a);
    MPI_Pack_size(1, MPI_DOUBLE, MPI_COMM_WORLD, &size_b);
-   MPI_Pack_size(1, MPI_INT,    MPI_COMM_WORLD, &size_n);
+   MPI_Pack_size(1, MPI_LONG,   MPI_COMM_WORLD, &size_n);
 
    total_size = size_a + size_b + size_n;
    pack_buf = (char*) malloc(total_size); 
 
    if (my_rank == 0) {
       
-      printf("Enter a, b, and n\n");
-      scanf("%lf %lf %d", a_p, b_p, n_p);
+      printf("Enter a, b, and n [and f(x)]\n");
+      scanf("%lf %lf %ld", a_p, b_p, n_p);
+      if (!Expr_read(stdin, prog_p, err))
+         fprintf(stderr, "f(x): %s\n", err);
       
       MPI_Pack(a_p, 1, MPI_DOUBLE, pack_buf, total_size, &position, MPI_COMM_WORLD);
       MPI_Pack(b_p, 1, MPI_DOUBLE, pack_buf, total_size, &position, MPI_COMM_WORLD);
-      MPI_Pack(n_p, 1, MPI_INT, pack_buf, total_size, &position, MPI_COMM_WORLD);
+      MPI_Pack(n_p, 1, MPI_LONG, pack_buf, total_size, &position, MPI_COMM_WORLD);
    }
    MPI_Bcast(pack_buf, total_size, MPI_PACKED, 0, MPI_COMM_WORLD);
 
@@ -104,32 +137,26 @@ void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p, int* n_p) {
 
    MPI_Unpack(pack_buf, total_size, &position, a_p, 1, MPI_DOUBLE, MPI_COMM_WORLD);
    MPI_Unpack(pack_buf, total_size, &position, b_p, 1, MPI_DOUBLE, MPI_COMM_WORLD);
-   MPI_Unpack(pack_buf, total_size, &position, n_p, 1, MPI_INT, MPI_COMM_WORLD);
+   MPI_Unpack(pack_buf, total_size, &position, n_p, 1, MPI_LONG, MPI_COMM_WORLD);
 
    free(pack_buf);
+
+   Expr_bcast(prog_p, 0, MPI_COMM_WORLD);
 }  /* Get_input */
 
 //Trap------------------------------------------------------------------
 double Trap(
       double left_endpt  /* in */, 
       double right_endpt /* in */, 
-      int    trap_count  /* in */, 
-      double base_len    /* in */) {
-   double estimate, x; 
-   int i;
-
-   estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
+      long   trap_count  /* in */, 
+      double base_len    /* in */,
+      const integrand_t* fn /* in */) {
+   double estimate; 
+
+   if (trap_count <= 0) return 0.0;
+   estimate = (fn->f(left_endpt) + fn->f(right_endpt))/2.0;
+   estimate += fn->trap_sum(left_endpt, base_len, 1, trap_count-1);
    estimate = estimate*base_len;
 
    return estimate;
 } /*  Trap  */
-
-
-//f------------------------------------------------------------------
-double f(double x) {
-   return x*x;
-} /* f */
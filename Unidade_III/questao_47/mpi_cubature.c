@@ -0,0 +1,182 @@
+/* File:     mpi_cubature.c
+ * Purpose:  Use MPI to estimate the integral of a function of 2 or 3
+ *           variables over a box, with the trapezoidal (or Simpson)
+ *           rule in every direction.  The grid of nodes is split into
+ *           blocks on a Cartesian grid of processes.
+ *
+ * Input:    x0 x1 nx y0 y1 ny [z0 z1 nz]:  the box and the number of
+ *           panels in each direction (6 numbers for 2D, 9 for 3D)
+ * Output:   Estimate of the integral, the error (if the exact value is
+ *           known), the elapsed time and the number of nodes per
+ *           second.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_cubature mpi_cubature.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_cubature
+ *              [integrand [trap|simpson]]
+ *
+ * Algorithm:
+ *    1.  Process 0 reads the box and broadcasts it.
+ *    2.  MPI_Dims_create and MPI_Cart_create arrange the processes in
+ *        a 2D or 3D grid;  the nodes in direction d are split among
+ *        the processes of the grid in that direction
+ *        (comum/partition.h).
+ *    3.  Each process sums its block of nodes (Cube_box_sum in
+ *        comum/cubature.h:  tiles of x values, rows vectorized).
+ *    4.  One MPI_Reduce (compensated, comum/summation.h) adds the
+ *        blocks on process 0.
+ *
+ * Notes:
+ *    1.  MPI_Dims_create gives the larger process counts to the first
+ *        dimensions;  they are given to z and y instead, so the x rows
+ *        (the vectorized loop) stay long.
+ *    2.  Counts are long:  10^4 panels in each of 3 directions is
+ *        10^12 nodes.  Each process only stores the nodes and weights
+ *        of its block along each axis.
+ *    3.  In 2D the integrands are evaluated with z = 0.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#include "../../comum/cubature.h"
+#include "../../comum/partition.h"
+
+#define MAX_LINE 512
+
+int Get_input(int my_rank, double lo[], double hi[], long int n[]);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, cart_rank, dim, rule, d;
+   int grid[CUBE_MAX_DIM] = {0, 0, 0}, periods[CUBE_MAX_DIM] = {0, 0, 0};
+   int cart_grid[CUBE_MAX_DIM], coords[CUBE_MAX_DIM];
+   double lo[CUBE_MAX_DIM], hi[CUBE_MAX_DIM], h;
+   double *node[CUBE_MAX_DIM], *weight[CUBE_MAX_DIM];
+   double local_sum, total_sum, start, finish, exact;
+   long int n[CUBE_MAX_DIM], count[CUBE_MAX_DIM];
+   double nodes;
+   part_t part;
+   const cube_integrand_t* fn;
+   MPI_Comm cart;
+
+   MPI_Init(NULL, NULL);
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   fn = Cube_find(argc > 1 ? argv[1] : NULL);
+   rule = Cube_rule_find(argc > 2 ? argv[2] : NULL);
+   if (fn == NULL || rule < 0) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand [trap|simpson]]\n",
+               argv[0]);
+         Cube_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   dim = Get_input(my_rank, lo, hi, n);
+   if (dim == 0) {
+      MPI_Finalize();
+      return 0;
+   }
+
+   /* Process grid, most processes along z (then y) */
+   MPI_Dims_create(comm_sz, dim, grid);
+   for (d = 0; d < dim; d++)
+      cart_grid[d] = grid[dim-1-d];
+   MPI_Cart_create(MPI_COMM_WORLD, dim, cart_grid, periods, 1, &cart);
+   MPI_Comm_rank(cart, &cart_rank);
+   MPI_Cart_coords(cart, cart_rank, dim, coords);
+
+   for (d = 0; d < CUBE_MAX_DIM; d++) {
+      if (d < dim) {
+         part = Partition(Cube_points(rule, n[d]), coords[d], cart_grid[d],
+               d == 0 ? PART_ALIGN : 1);
+         h = (hi[d] - lo[d])/n[d];
+         count[d] = part.count;
+         node[d] = malloc((count[d] > 0 ? count[d] : 1)*sizeof(double));
+         weight[d] = malloc((count[d] > 0 ? count[d] : 1)*sizeof(double));
+         Cube_nodes(rule, lo[d], h, n[d], part.first, count[d], node[d],
+               weight[d]);
+      } else {
+         /* 2D:  one node z = 0 with weight 1 */
+         count[d] = 1;
+         node[d] = malloc(sizeof(double));
+         weight[d] = malloc(sizeof(double));
+         node[d][0] = 0.0;
+         weight[d][0] = 1.0;
+      }
+   }
+
+   MPI_Barrier(cart);
+   start = MPI_Wtime();
+   local_sum = Cube_box_sum(fn, node, weight, count);
+   total_sum = Sum2_reduce(local_sum, 0, cart);
+   finish = MPI_Wtime();
+
+   if (cart_rank == 0) {
+      nodes = 1.0;
+      for (d = 0; d < dim; d++)
+         nodes *= Cube_points(rule, n[d]);
+      printf("f = %s\n", fn->formula);
+      printf("With %s rule, n = %ld", cube_rule_names[rule], n[0]);
+      for (d = 1; d < dim; d++)
+         printf(" x %ld", n[d]);
+      printf(" panels (%.3e nodes), our estimate\n", nodes);
+      printf("of the integral over the box = %.15e\n", total_sum);
+      if (fn->exact != NULL) {
+         exact = fn->exact(lo, hi, dim);
+         printf("Exact = %.15e, error = %.3e\n", exact, total_sum - exact);
+      }
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Nodes per second = %.3e\n", nodes/(finish - start));
+      printf("Process grid = %d", cart_grid[0]);
+      for (d = 1; d < dim; d++)
+         printf(" x %d", cart_grid[d]);
+      printf("\n");
+   }
+
+   for (d = 0; d < CUBE_MAX_DIM; d++) {
+      free(node[d]);
+      free(weight[d]);
+   }
+   MPI_Comm_free(&cart);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read the box and the panels on process 0 and broadcast
+ *               them
+ * Input args:   my_rank
+ * Output args:  lo, hi:  corners of the box
+ *               n:  panels in each direction
+ * Return val:   dimension (2 or 3), or 0 if the input is bad
+ */
+int Get_input(
+      int       my_rank  /* in  */,
+      double    lo[]     /* out */,
+      double    hi[]     /* out */,
+      long int  n[]      /* out */) {
+   char line[MAX_LINE];
+   int fields = 0, dim = 0, d;
+
+   if (my_rank == 0) {
+      printf("Enter x0 x1 nx y0 y1 ny [z0 z1 nz]\n");
+      if (fgets(line, MAX_LINE, stdin) != NULL)
+         fields = sscanf(line, "%lf %lf %ld %lf %lf %ld %lf %lf %ld",
+               &lo[0], &hi[0], &n[0], &lo[1], &hi[1], &n[1],
+               &lo[2], &hi[2], &n[2]);
+      dim = (fields == 6 || fields == 9) ? fields/3 : 0;
+      for (d = 0; d < dim; d++)
+         if (n[d] < 1) dim = 0;
+      if (dim == 0)
+         fprintf(stderr, "Expected 6 or 9 numbers, with n >= 1\n");
+   }
+   MPI_Bcast(&dim, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   MPI_Bcast(lo, CUBE_MAX_DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(hi, CUBE_MAX_DIM, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(n, CUBE_MAX_DIM, MPI_LONG, 0, MPI_COMM_WORLD);
+   return dim;
+}  /* Get_input */
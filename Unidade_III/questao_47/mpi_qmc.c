@@ -0,0 +1,335 @@
+/* File:     mpi_qmc.c
+ * Purpose:  Estimate the integral of a function of d variables over
+ *           the cube [a, b]^d by quasi-Monte Carlo (randomized Sobol
+ *           points) or Monte Carlo, with MPI (and optionally OpenMP),
+ *           stopping as soon as the estimated error is small enough.
+ *
+ * Input:    a, b, d, n_max, tol:  the cube, its dimension
+ *           (1 <= d <= QMC_MAX_DIM), the most points to use and the
+ *           target half-width of the 95% confidence interval
+ * Output:   One line per round (points so far, estimate, half-width),
+ *           then the estimate with its confidence interval, its error
+ *           (from the exact value) and the elapsed time.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_qmc mpi_qmc.c -lm
+ *           hybrid MPI+OpenMP version:
+ *           mpicc -g -Wall -O2 -fopenmp -o mpi_qmc_omp mpi_qmc.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_qmc
+ *              [integrand [sobol|mc [seed]]]
+ *
+ * Algorithm:
+ *    The points are taken in rounds:  the first has QMC_FIRST points,
+ *    and each of the others doubles the total, so Sobol estimates are
+ *    always made from 2^k points.  In a round the new point indices
+ *    are split among the processes (and among the threads of each
+ *    process) with comum/partition.h;  every worker jumps straight to
+ *    its first index (comum/qmc.h).  The sums of the round are added
+ *    with an OpenMP reduction and an MPI_Allreduce, so every process
+ *    sees the same totals and takes the same decision to stop.
+ *
+ *    sobol:  QMC_REPLICATES independent random digital shifts of the
+ *            same Sobol points.  The estimate is the mean of the
+ *            replicates' estimates, and the error comes from their
+ *            spread (Student t with QMC_REPLICATES-1 degrees of
+ *            freedom).
+ *    mc:     pseudo-random points from a counter-based generator.  The
+ *            running sums of f - f0 and (f - f0)^2, where f0 is f at
+ *            point 0, give the variance, and the error is
+ *            1.96*sqrt(variance/N).
+ *
+ * Notes:
+ *    1.  The Sobol sequence has at most 2^32 points, so n_max is
+ *        limited to that with sobol.
+ *    2.  The results don't depend on the number of processes or
+ *        threads except for rounding:  point i is always the same.
+ *    3.  With mc the samples are shifted by f0 because the sums of f
+ *        and f^2 cancel when the mean of f is large compared with its
+ *        spread (e.g. sumsq on [10^6, 10^6 + 1]^d):  the variance came
+ *        out too small and the run stopped early.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "../../comum/qmc.h"
+#include "../../comum/partition.h"
+
+#define QMC_FIRST       (1L << 12)
+#define QMC_REPLICATES  16
+#define QMC_T_975       2.131      /* Student t, 15 degrees of freedom */
+#define QMC_Z_975       1.96
+#define QMC_SEED        12345ULL
+
+enum {METHOD_SOBOL, METHOD_MC};
+
+typedef struct {
+   const qmc_integrand_t* fn;
+   int    method;
+   int    dim;
+   double a, b;
+   unsigned long long seed;
+   double mc_shift;               /* mc:  f0, subtracted from each f  */
+   sobol_t  sobol;
+   unsigned shift[QMC_REPLICATES][QMC_MAX_DIM];
+} qmc_job_t;
+
+int  Get_input(int my_rank, double* a_p, double* b_p, int* dim_p,
+      long int* n_max_p, double* tol_p);
+void Round_sums(const qmc_job_t* job, long int first, long int count,
+      double sums[], int n_sums);
+void Sums_of_range(const qmc_job_t* job, long int first, long int count,
+      double sums[]);
+void Estimate(const qmc_job_t* job, const double total[], long int n,
+      double* estimate_p, double* half_p);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, n_sums, r, d;
+   long int n_max, n = 0, round_n;
+   double tol, estimate = 0.0, half = INFINITY, start, finish, exact;
+   double round_sums[QMC_REPLICATES], total[QMC_REPLICATES];
+   part_t part;
+   qmc_job_t job;
+
+#  ifdef _OPENMP
+   int provided;
+
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+#  else
+   MPI_Init(NULL, NULL);
+#  endif
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   job.fn = Qmc_find(argc > 1 ? argv[1] : NULL);
+   job.method = (argc > 2 && strcmp(argv[2], "mc") == 0)
+      ? METHOD_MC : METHOD_SOBOL;
+   job.seed = argc > 3 ? strtoull(argv[3], NULL, 10) : QMC_SEED;
+   if (job.fn == NULL || (argc > 2 && job.method == METHOD_SOBOL
+            && strcmp(argv[2], "sobol") != 0)) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand [sobol|mc [seed]]]\n",
+               argv[0]);
+         Qmc_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   if (!Get_input(my_rank, &job.a, &job.b, &job.dim, &n_max, &tol)) {
+      MPI_Finalize();
+      return 0;
+   }
+   if (job.method == METHOD_SOBOL && n_max > (1L << QMC_BITS))
+      n_max = 1L << QMC_BITS;
+   Sobol_init(&job.sobol, job.dim);
+   for (r = 0; r < QMC_REPLICATES; r++)
+      for (d = 0; d < job.dim; d++)
+         job.shift[r][d] = (unsigned) (Rng_u64(job.seed,
+                  (unsigned long long) r*QMC_MAX_DIM + d) >> 32);
+   n_sums = (job.method == METHOD_SOBOL) ? QMC_REPLICATES : 2;
+   memset(total, 0, sizeof(total));
+   job.mc_shift = 0.0;
+   if (job.method == METHOD_MC) {
+      /* Every process computes the same f0 from point 0 */
+      Sums_of_range(&job, 0, 1, round_sums);
+      job.mc_shift = round_sums[0];
+   }
+
+   if (my_rank == 0)
+      printf("%14s %22s %12s\n", "points", "estimate", "half-width");
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   while (n < n_max && !(half <= tol)) {
+      round_n = (n == 0) ? QMC_FIRST : n;
+      if (round_n > n_max - n) round_n = n_max - n;
+
+      part = Partition(round_n, my_rank, comm_sz, 1);
+      Round_sums(&job, n + part.first, part.count, round_sums, n_sums);
+      MPI_Allreduce(MPI_IN_PLACE, round_sums, n_sums, MPI_DOUBLE, MPI_SUM,
+            MPI_COMM_WORLD);
+      for (r = 0; r < n_sums; r++)
+         total[r] += round_sums[r];
+      n += round_n;
+
+      Estimate(&job, total, n, &estimate, &half);
+      if (my_rank == 0)
+         printf("%14ld %22.15e %12.3e\n", n, estimate, half);
+   }
+   finish = MPI_Wtime();
+
+   if (my_rank == 0) {
+      printf("f = %s, d = %d, cube [%f, %f]^d\n", job.fn->formula, job.dim,
+            job.a, job.b);
+      printf("Method: %s, %ld points, %s\n",
+            job.method == METHOD_SOBOL ? "sobol" : "mc", n,
+            half <= tol ? "target error reached" : "n_max reached");
+      printf("Estimate = %.15e +- %.3e (95%%)\n", estimate, half);
+      exact = job.fn->exact(job.a, job.b, job.dim);
+      printf("Exact = %.15e, error = %.3e\n", exact, estimate - exact);
+      printf("Elapsed time = %.4f\n", finish - start);
+#     ifdef _OPENMP
+      printf("Processes x threads = %d x %d\n", comm_sz,
+            omp_get_max_threads());
+#     endif
+   }
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read a, b, d, n_max and tol on process 0 and
+ *               broadcast them
+ * Return val:   1 if the input is good, 0 otherwise
+ */
+int Get_input(
+      int       my_rank  /* in  */,
+      double*   a_p      /* out */,
+      double*   b_p      /* out */,
+      int*      dim_p    /* out */,
+      long int* n_max_p  /* out */,
+      double*   tol_p    /* out */) {
+   double dbuf[3];
+   long int lbuf[2] = {0, 0};
+
+   if (my_rank == 0) {
+      printf("Enter a, b, d, n_max and tol\n");
+      if (scanf("%lf %lf %ld %ld %lf", &dbuf[0], &dbuf[1], &lbuf[0],
+               &lbuf[1], &dbuf[2]) != 5
+            || lbuf[0] < 1 || lbuf[0] > QMC_MAX_DIM || lbuf[1] < 1) {
+         fprintf(stderr, "Expected a b d n_max tol, with 1 <= d <= %d\n",
+               QMC_MAX_DIM);
+         lbuf[0] = 0;
+      }
+   }
+   MPI_Bcast(dbuf, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(lbuf, 2, MPI_LONG, 0, MPI_COMM_WORLD);
+   *a_p = dbuf[0];
+   *b_p = dbuf[1];
+   *tol_p = dbuf[2];
+   *dim_p = (int) lbuf[0];
+   *n_max_p = lbuf[1];
+   return lbuf[0] != 0;
+}  /* Get_input */
+
+/*------------------------------------------------------------------
+ * Function:     Round_sums
+ * Purpose:      This process' sums over the points first..first+count-1
+ *               (split among the threads in the hybrid version)
+ * Output arg:   sums:  n_sums values (see Sums_of_range)
+ */
+void Round_sums(
+      const qmc_job_t* job   /* in  */,
+      long int  first        /* in  */,
+      long int  count        /* in  */,
+      double    sums[]       /* out */,
+      int       n_sums       /* in  */) {
+   int r;
+
+   for (r = 0; r < n_sums; r++)
+      sums[r] = 0.0;
+#  ifdef _OPENMP
+#  pragma omp parallel default(none) shared(job, first, count, n_sums) \
+      reduction(+: sums[:n_sums])
+   {
+      double mine[QMC_REPLICATES];
+      part_t part = Partition(count, omp_get_thread_num(),
+            omp_get_num_threads(), 1);
+      int s;
+
+      Sums_of_range(job, first + part.first, part.count, mine);
+      for (s = 0; s < n_sums; s++)
+         sums[s] += mine[s];
+   }
+#  else
+   Sums_of_range(job, first, count, sums);
+#  endif
+}  /* Round_sums */
+
+/*------------------------------------------------------------------
+ * Function:     Sums_of_range
+ * Purpose:      Sums of f over the points first..first+count-1
+ * Output arg:   sums:  sobol:  sums[r] = sum of f over the points
+ *                         with shift r, r < QMC_REPLICATES
+ *                      mc:     sums[0] = sum of f - f0,
+ *                              sums[1] = sum of (f - f0)^2
+ */
+void Sums_of_range(
+      const qmc_job_t* job   /* in  */,
+      long int  first        /* in  */,
+      long int  count        /* in  */,
+      double    sums[]       /* out */) {
+   double x[QMC_MAX_DIM], len = job->b - job->a, y;
+   sobol_point_t pt;
+   long int i;
+   int r, d;
+
+   if (job->method == METHOD_MC) {
+      sums[0] = sums[1] = 0.0;
+      for (i = first; i < first + count; i++) {
+         for (d = 0; d < job->dim; d++)
+            x[d] = job->a + len*Rng_uniform(job->seed,
+                  (unsigned long long) i*job->dim + d);
+         y = job->fn->f(x, job->dim) - job->mc_shift;
+         sums[0] += y;
+         sums[1] += y*y;
+      }
+      return;
+   }
+
+   for (r = 0; r < QMC_REPLICATES; r++)
+      sums[r] = 0.0;
+   if (count <= 0) return;
+   Sobol_seek(&job->sobol, &pt, first);
+   for (i = 0; i < count; i++) {
+      for (r = 0; r < QMC_REPLICATES; r++) {
+         for (d = 0; d < job->dim; d++)
+            x[d] = job->a + len*Qmc_unit(pt.x[d], job->shift[r][d]);
+         sums[r] += job->fn->f(x, job->dim);
+      }
+      /* Point 2^QMC_BITS - 1, the last one, has no next */
+      if (i + 1 < count) Sobol_next(&job->sobol, &pt);
+   }
+}  /* Sums_of_range */
+
+/*------------------------------------------------------------------
+ * Function:     Estimate
+ * Purpose:      Estimate of the integral and half-width of its 95%
+ *               confidence interval, from the totals of n points
+ */
+void Estimate(
+      const qmc_job_t* job   /* in  */,
+      const double total[]   /* in  */,
+      long int  n            /* in  */,
+      double*   estimate_p   /* out */,
+      double*   half_p       /* out */) {
+   double volume = pow(job->b - job->a, job->dim), mean, var = 0.0, rep;
+   int r;
+
+   if (job->method == METHOD_MC) {
+      mean = total[0]/n;
+      if (n > 1)
+         var = (total[1]/n - mean*mean)*n/(n - 1.0);
+      if (var < 0.0) var = 0.0;
+      *estimate_p = volume*(job->mc_shift + mean);
+      *half_p = QMC_Z_975*volume*sqrt(var/n);
+      return;
+   }
+
+   mean = 0.0;
+   for (r = 0; r < QMC_REPLICATES; r++)
+      mean += total[r]/n;
+   mean /= QMC_REPLICATES;
+   for (r = 0; r < QMC_REPLICATES; r++) {
+      rep = total[r]/n - mean;
+      var += rep*rep;
+   }
+   var /= QMC_REPLICATES - 1;
+   *estimate_p = volume*mean;
+   *half_p = QMC_T_975*volume*sqrt(var/QMC_REPLICATES);
+}  /* Estimate */
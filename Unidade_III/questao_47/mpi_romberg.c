@@ -0,0 +1,224 @@
+/* File:     mpi_romberg.c
+ * Purpose:  Use MPI to implement Romberg integration:  the
+ *           trapezoidal rule with n, 2n, 4n, ... trapezoids, followed
+ *           by Richardson extrapolation.  Each refinement only
+ *           evaluates f at the new midpoints; the sums of the coarser
+ *           levels are kept on every process and reused.
+ *
+ * Input:    a, b:    endpoints of the interval of integration
+ *           n:       number of trapezoids of the first level
+ *           levels:  maximum number of refinements (0 to MAX_LEVELS;
+ *                    n*2^levels must fit in a long)
+ *           tol:     stop when two consecutive extrapolated values
+ *                    differ by less than tol (0 runs every level)
+ *           optionally followed by the formula of f(x)
+ * Output:   For each level, the trapezoidal estimate and the
+ *           extrapolated estimate, and the final estimate of the
+ *           integral from a to b of f(x).
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_romberg mpi_romberg.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_romberg [integrand]
+ *
+ * Algorithm:
+ *    1.  Level 0:  each process sums f over its block of the n+1
+ *        points of the first grid (endpoints with weight 1/2).
+ *    2.  Level k:  the grid spacing is halved, and each process
+ *        adds f at its block of the n*2^(k-1) new midpoints to its
+ *        running sum.
+ *    3.  An MPI_Allreduce of the running sums gives T_k = h_k * sum
+ *        on every process, and every process updates the same row
+ *        of the Romberg table, so they all stop at the same level.
+ *
+ * Notes:
+ *    1.  Refining to n*2^L trapezoids evaluates f n*2^L + 1 times in
+ *        all, the same as a single run of mpi_trap4_time with that n,
+ *        instead of the sum of the runs with n, 2n, ..., n*2^L.
+ *    2.  The extrapolation assumes f is smooth on [a, b]; for other
+ *        functions use the trapezoidal column.
+ */
+#include <stdio.h>
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+#include "../../comum/integrands.h"
+#include "../../comum/expr.h"
+#include "../../comum/partition.h"
+
+#define MAX_LEVELS 48
+
+void Get_input(int my_rank, double* a_p, double* b_p, long int* n_p,
+      int* levels_p, double* tol_p, expr_prog_t* prog_p);
+
+double Level_sum(double a, double h, long int n, int level,
+      int my_rank, int comm_sz, const integrand_t* fn);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, level, levels, j, done;
+   double a, b, h, tol, local_sum, total_sum, factor;
+   double row[MAX_LEVELS+1], prev_row[MAX_LEVELS+1];
+   double start, finish;
+   long int n;
+   const integrand_t* fn;   /* Function we're integrating */
+   expr_prog_t prog;        /* Formula typed in, if any   */
+
+   MPI_Init(NULL, NULL);
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   fn = Integrand_find(argc > 1 ? argv[1] : NULL);
+   if (fn == NULL) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand]\n", argv[0]);
+         Integrand_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   Get_input(my_rank, &a, &b, &n, &levels, &tol, &prog);
+   if (prog.n_instr == EXPR_BAD_PROGRAM) {
+      MPI_Finalize();
+      return 0;
+   }
+   if (prog.n_instr != EXPR_NO_PROGRAM) fn = Expr_integrand(&prog);
+   if (levels < 0) levels = 0;
+   if (levels > MAX_LEVELS) levels = MAX_LEVELS;
+   if (n < 1 || n > LONG_MAX >> levels) {
+      if (my_rank == 0)
+         fprintf(stderr, "With %d levels n must be from 1 to %ld\n",
+               levels, LONG_MAX >> levels);
+      MPI_Finalize();
+      return 0;
+   }
+
+   if (my_rank == 0) {
+      printf("f(x) = %s\n", fn->formula);
+      printf("%6s %20s %24s %24s %10s\n", "level", "n", "trapezoidal",
+            "extrapolated", "time");
+   }
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = finish = MPI_Wtime();
+   local_sum = 0.0;
+   done = 0;
+   for (level = 0; level <= levels && !done; level++) {
+      h = ldexp((b-a)/n, -level);
+      local_sum += Level_sum(a, h, n, level, my_rank, comm_sz, fn);
+      MPI_Allreduce(&local_sum, &total_sum, 1, MPI_DOUBLE, MPI_SUM,
+            MPI_COMM_WORLD);
+
+      /* Next row of the Romberg table */
+      row[0] = h*total_sum;
+      factor = 1.0;
+      for (j = 1; j <= level; j++) {
+         factor *= 4.0;
+         row[j] = row[j-1] + (row[j-1] - prev_row[j-1])/(factor - 1.0);
+      }
+      finish = MPI_Wtime();
+
+      if (my_rank == 0)
+         printf("%6d %20.0f %24.15e %24.15e %10.4f\n", level,
+               ldexp(n, level), row[0], row[level], finish - start);
+
+      done = (level > 0 && fabs(row[level] - prev_row[level-1]) < tol);
+      for (j = 0; j <= level; j++)
+         prev_row[j] = row[j];
+   }
+   level--;
+
+   if (my_rank == 0) {
+      printf("With n = %.0f trapezoids and %d extrapolations, our estimate\n",
+            ldexp(n, level), level);
+      printf("of the integral from %f to %f = %.15e\n", a, b,
+            prev_row[level]);
+      printf("Elapsed time = %.4f\n", finish - start);
+   }
+
+   MPI_Finalize();
+
+   return 0;
+} /*  main  */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read the input on process 0 and broadcast it
+ * Input args:   my_rank
+ * Output args:  a_p, b_p, n_p, levels_p, tol_p:  see the header
+ *               prog_p:  the formula of f(x), if one was given
+ */
+void Get_input(
+      int           my_rank   /* in  */,
+      double*       a_p       /* out */,
+      double*       b_p       /* out */,
+      long int*     n_p       /* out */,
+      int*          levels_p  /* out */,
+      double*       tol_p     /* out */,
+      expr_prog_t*  prog_p    /* out */) {
+   double dbuf[3];
+   long int lbuf[2];
+   char err[EXPR_MAX_TEXT];
+
+   if (my_rank == 0) {
+      printf("Enter a, b, n, levels and tol [and f(x)]\n");
+      scanf("%lf %lf %ld %ld %lf", &dbuf[0], &dbuf[1], &lbuf[0],
+            &lbuf[1], &dbuf[2]);
+      if (!Expr_read(stdin, prog_p, err))
+         fprintf(stderr, "f(x): %s\n", err);
+   }
+   MPI_Bcast(dbuf, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(lbuf, 2, MPI_LONG, 0, MPI_COMM_WORLD);
+   Expr_bcast(prog_p, 0, MPI_COMM_WORLD);
+
+   *a_p = dbuf[0];
+   *b_p = dbuf[1];
+   *tol_p = dbuf[2];
+   *n_p = lbuf[0];
+   *levels_p = (int) lbuf[1];
+}  /* Get_input */
+
+/*------------------------------------------------------------------
+ * Function:     Level_sum
+ * Purpose:      Sum of f over this process' share of the points that
+ *               are new at this level
+ * Input args:   a:      left endpoint
+ *               h:      spacing of the grid of this level
+ *               n:      number of trapezoids of level 0
+ *               level
+ *               my_rank, comm_sz
+ *               fn
+ * Return val:   level 0:  sum of f(a + i*h), i = 0..n, with the two
+ *               endpoints halved;  level k > 0:  sum of f at the
+ *               midpoints a + (2j+1)*h, j = 0..n*2^(k-1)-1
+ */
+double Level_sum(
+      double    a        /* in */,
+      double    h        /* in */,
+      long int  n        /* in */,
+      int       level    /* in */,
+      int       my_rank  /* in */,
+      int       comm_sz  /* in */,
+      const integrand_t* fn /* in */) {
+   part_t part;
+   long int first, count;
+   double sum = 0.0;
+
+   if (level == 0) {
+      part = Partition(n+1, my_rank, comm_sz, PART_ALIGN);
+      first = part.first;
+      count = part.count;
+      if (count == 0) return 0.0;
+      if (first == 0) {
+         sum += fn->f(a)/2.0;
+         first++;
+         count--;
+      }
+      if (first + count == n+1 && count > 0) {
+         sum += fn->f(a + n*h)/2.0;
+         count--;
+      }
+      return sum + fn->trap_sum(a, h, first, count);
+   }
+
+   part = Partition(n << (level-1), my_rank, comm_sz, PART_ALIGN);
+   return fn->trap_sum(a + h, 2.0*h, part.first, part.count);
+}  /* Level_sum */
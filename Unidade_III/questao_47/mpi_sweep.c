@@ -0,0 +1,230 @@
+/* File:     mpi_sweep.c
+ * Purpose:  Use MPI (and OpenMP) to integrate a family of functions
+ *           f(x; t) over the same [a, b] for many values of t:  the
+ *           values of t are split among the processes, and each
+ *           process' values among its threads, in tiles of
+ *           SWEEP_THETA_TILE.  Every tile of t values is integrated
+ *           against tiles of x nodes (comum/sweep.h).
+ *
+ * Input:    a b n t0 t1 m:  the interval, the number of panels, and m
+ *           values of t evenly spaced from t0 to t1
+ * Output:   The number of integrals, the elapsed time, the function
+ *           evaluations per second and the largest error (if the
+ *           exact integrals are known).  If an output file is given,
+ *           one line "t integral" per value of t is written to it.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_sweep mpi_sweep.c -lm
+ *           hybrid MPI+OpenMP version:
+ *           mpicc -g -Wall -O2 -fopenmp -o mpi_sweep_omp mpi_sweep.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_sweep
+ *              [family [trap|simpson [output file]]]
+ *
+ * Algorithm:
+ *    1.  Process 0 reads the input and broadcasts it.
+ *    2.  Each process gets a block of the m values of t
+ *        (comum/partition.h) and integrates them a tile at a time;
+ *        in the hybrid version the tiles are dealt to the threads
+ *        with schedule(dynamic).
+ *    3.  MPI_Gatherv collects the integrals on process 0.
+ *
+ * Notes:
+ *    1.  t_k = t0 + k*(t1 - t0)/(m - 1) is computed from k, so it
+ *        doesn't depend on the number of processes.
+ *    2.  Only the nodes and weights of one tile of x (SWEEP_X_TILE
+ *        nodes) are stored per thread, so n can be as large as
+ *        wanted.
+ *    3.  In the hybrid version MPI is initialized with
+ *        MPI_THREAD_FUNNELED:  only the master thread calls MPI.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "../../comum/sweep.h"
+#include "../../comum/partition.h"
+
+#define MAX_LINE 256
+
+int Get_input(int my_rank, double* a_p, double* b_p, long int* n_p,
+      double* t0_p, double* t1_p, long int* m_p);
+void Sweep(const sweep_integrand_t* fn, int rule, double a, double b,
+      long int n, double t0, double dt, part_t part, double result[]);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, rule, q;
+   double a, b, t0, t1, dt, start, finish, err, max_err = 0.0, exact;
+   double *result, *all = NULL;
+   long int n, m, k;
+   int *counts = NULL, *displs = NULL;
+   part_t part, other;
+   const sweep_integrand_t* fn;
+   FILE* out;
+
+#  ifdef _OPENMP
+   int provided;
+
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+#  else
+   MPI_Init(NULL, NULL);
+#  endif
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   fn = Sweep_find(argc > 1 ? argv[1] : NULL);
+   rule = Cube_rule_find(argc > 2 ? argv[2] : NULL);
+   if (fn == NULL || rule < 0 || argc > 4) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s "
+               "[family [trap|simpson [output file]]]\n", argv[0]);
+         Sweep_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   if (!Get_input(my_rank, &a, &b, &n, &t0, &t1, &m)) {
+      MPI_Finalize();
+      return 0;
+   }
+   dt = (m > 1) ? (t1 - t0)/(m - 1) : 0.0;
+   part = Partition(m, my_rank, comm_sz, 1);
+   result = malloc((part.count > 0 ? part.count : 1)*sizeof(double));
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   Sweep(fn, rule, a, b, n, t0, dt, part, result);
+
+   /* The int counts of MPI_Gatherv limit m to 2^31 */
+   if (my_rank == 0) {
+      all = malloc(m*sizeof(double));
+      counts = malloc(comm_sz*sizeof(int));
+      displs = malloc(comm_sz*sizeof(int));
+      for (q = 0; q < comm_sz; q++) {
+         other = Partition(m, q, comm_sz, 1);
+         counts[q] = other.count;
+         displs[q] = other.first;
+      }
+   }
+   MPI_Gatherv(result, part.count, MPI_DOUBLE, all, counts, displs,
+         MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   finish = MPI_Wtime();
+
+   if (my_rank == 0) {
+      for (k = 0; fn->exact != NULL && k < m; k++) {
+         exact = fn->exact(a, b, t0 + k*dt);
+         err = fabs(all[k] - exact);
+         if (isfinite(exact) && err > max_err) max_err = err;
+      }
+      printf("f(x; t) = %s\n", fn->formula);
+      printf("With %s rule, n = %ld panels, %ld values of t from %g to %g\n",
+            cube_rule_names[rule], n, m, t0, t1);
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Evaluations per second = %.3e\n",
+            (double) Cube_points(rule, n)*m/(finish - start));
+      if (fn->exact != NULL) printf("Max error = %.3e\n", max_err);
+#     ifdef _OPENMP
+      printf("Processes x threads = %d x %d\n", comm_sz,
+            omp_get_max_threads());
+#     endif
+      if (argc == 4) {
+         if ((out = fopen(argv[3], "w")) == NULL) {
+            fprintf(stderr, "Can't open %s\n", argv[3]);
+         } else {
+            for (k = 0; k < m; k++)
+               fprintf(out, "%.15e %.15e\n", t0 + k*dt, all[k]);
+            fclose(out);
+         }
+      }
+      free(displs);
+      free(counts);
+      free(all);
+   }
+
+   free(result);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read the input on process 0 and broadcast it
+ * Input args:   my_rank
+ * Output args:  a_p, b_p, n_p:  interval and panels
+ *               t0_p, t1_p, m_p:  range and number of values of t
+ * Return val:   1 if the input is good, 0 otherwise
+ */
+int Get_input(
+      int       my_rank  /* in  */,
+      double*   a_p      /* out */,
+      double*   b_p      /* out */,
+      long int* n_p      /* out */,
+      double*   t0_p     /* out */,
+      double*   t1_p     /* out */,
+      long int* m_p      /* out */) {
+   char line[MAX_LINE];
+   double dbl[4];
+   long int lng[2];
+   int ok = 0;
+
+   if (my_rank == 0) {
+      printf("Enter a, b, n, t0, t1 and m\n");
+      if (fgets(line, MAX_LINE, stdin) != NULL)
+         ok = sscanf(line, "%lf %lf %ld %lf %lf %ld", &dbl[0], &dbl[1],
+               &lng[0], &dbl[2], &dbl[3], &lng[1]) == 6
+            && lng[0] >= 1 && lng[1] >= 1 && lng[1] <= 0x7fffffffL;
+      if (!ok)
+         fprintf(stderr, "Expected a b n t0 t1 m, with n, m >= 1\n");
+   }
+   MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   MPI_Bcast(dbl, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(lng, 2, MPI_LONG, 0, MPI_COMM_WORLD);
+   *a_p = dbl[0];
+   *b_p = dbl[1];
+   *t0_p = dbl[2];
+   *t1_p = dbl[3];
+   *n_p = lng[0];
+   *m_p = lng[1];
+   return ok;
+}  /* Get_input */
+
+/*------------------------------------------------------------------
+ * Function:     Sweep
+ * Purpose:      Integrate f(x; t_k) for the values k of part, a tile
+ *               of SWEEP_THETA_TILE at a time
+ * Input args:   fn, rule, a, b, n
+ *               t0, dt:  t_k = t0 + k*dt
+ *               part:  this process' values of k
+ * Output arg:   result:  part.count integrals
+ */
+void Sweep(
+      const sweep_integrand_t* fn /* in  */,
+      int          rule     /* in  */,
+      double       a        /* in  */,
+      double       b        /* in  */,
+      long int     n        /* in  */,
+      double       t0       /* in  */,
+      double       dt       /* in  */,
+      part_t       part     /* in  */,
+      double       result[] /* out */) {
+   long int tiles = (part.count + SWEEP_THETA_TILE - 1)/SWEEP_THETA_TILE;
+   long int tile;
+   double h = (b-a)/n;
+
+#  ifdef _OPENMP
+#  pragma omp parallel for schedule(dynamic) default(none) \
+      shared(fn, rule, a, h, n, t0, dt, part, result, tiles)
+#  endif
+   for (tile = 0; tile < tiles; tile++) {
+      double theta[SWEEP_THETA_TILE];
+      long int first = tile*SWEEP_THETA_TILE;
+      int count = (part.count - first < SWEEP_THETA_TILE)
+         ? part.count - first : SWEEP_THETA_TILE, j;
+
+      for (j = 0; j < count; j++)
+         theta[j] = t0 + (part.first + first + j)*dt;
+      Sweep_tile(fn, rule, a, h, n, theta, count, result + first);
+   }
+}  /* Sweep */
@@ -5,12 +5,18 @@
  *           compute the global sum.
  *
  * Input:    The endpoints of the interval of integration and the number
- *           of trapezoids
+ *           of trapezoids, optionally followed (on the same line) by
+ *           the formula of f(x), e.g. "0 2 1000000 sin(x)*exp(-x*x)"
  * Output:   Estimate of the integral from a to b of f(x)
- *           using the trapezoidal rule and n trapezoids.
+ *           using the trapezoidal rule and n trapezoids (or n panels
+ *           of another rule).
  *
- * Compile:  mpicc -g -Wall -o mpi_trap4_time mpi_trap4_time.c
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap4_time mpi_trap4_time.c -lm
+ *           hybrid MPI+OpenMP version:
+ *           mpicc -g -Wall -O2 -fopenmp -o mpi_trap4_time_omp \
+ *              mpi_trap4_time.c -lm
  * Run:      mpiexec -n <number of processes> ./mpi_trap4_time
+ *              [integrand [rule [summation]]]
  *
  * Algorithm:
  *    1.  Each process calculates "its" interval of
@@ -21,53 +27,314 @@
  *    3b. Process 0 sums the calculations received from
  *        the individual processes and prints the result.
  *
- * Note:  f(x) is all hardwired.
+ * Notes:
+ *    1.  f(x) is chosen on the command line from
+ *        comum/integrands.h (default x^2), unless a formula is given
+ *        in the input.  The formula is compiled on process 0 and
+ *        broadcast as bytecode (see comum/expr.h).
+ *    2.  The sum in Trap is done by the integrand's SIMD kernel
+ *        (AVX-512, AVX2 or scalar, chosen at run time).  See
+ *        comum/trap_simd.h.
+ *    3.  The rule applied to each process' panels can be the
+ *        trapezoidal rule (default), Simpson, Boole or
+ *        Gauss-Legendre.  See comum/quad_rules.h.
+ *    4.  The summation mode (plain, kahan, pairwise or repro) applies
+ *        to the sums in Trap;  with kahan or pairwise the processes'
+ *        results are also combined by a compensated MPI_Reduce.  With
+ *        repro the processes (and threads) get whole blocks of
+ *        REPRO_BLOCK panels, sum them into exact accumulators, and the
+ *        accumulators are combined by an integer MPI_Reduce, so the
+ *        result has the same bits for any number of processes and
+ *        threads.  The checkpoints and batch mode combine the results
+ *        as kahan does;  the farm mode keeps repro, and the cache
+ *        isn't used with it.  See comum/summation.h.
+ *    5.  n can be any (64-bit) number;  the panels are split among
+ *        the processes by comum/partition.h.
+ *    6.  If the environment variable TRAP_CACHE names a directory (on
+ *        process 0), the trapezoidal rule uses the result cache kept
+ *        there, with one entry per summation mode.  The new samples
+ *        of each level are split among the processes (and threads).
+ *        See comum/trap_cache.h.
+ *    7.  In the hybrid version each process splits its panels among
+ *        OMP_NUM_THREADS threads (a parallel region with a reduction,
+ *        as in omp_trap2b.c).  MPI is initialized with
+ *        MPI_THREAD_FUNNELED:  only the master thread calls MPI.  See
+ *        rodar_hibrido.sh for a sweep of processes x threads.
+ *    8.  If the environment variable TRAP_CALIBRATE is set (on
+ *        process 0), each process first times its Trap on a short
+ *        run of TRAP_CALIBRATE panels (CALIB_PANELS if the value
+ *        isn't a positive number, e.g. TRAP_CALIBRATE=yes) of the
+ *        real integrand and rule.  The rates
+ *        (panels per second) are exchanged with one MPI_Allgather and
+ *        local_a, local_b are chosen so every process gets panels in
+ *        proportion to its rate (Weighted_partition in
+ *        comum/partition.h).  This is for processes that share their
+ *        cores with other jobs;  the calibration time is included in
+ *        the elapsed time.
+ *    9.  If the environment variable TRAP_CHECKPOINT names a file (on
+ *        process 0), the panels are cut into blocks that don't depend
+ *        on the number of processes, and the sum of each finished
+ *        block is written to the file.  If the job is stopped, running
+ *        it again with the same input (and any number of processes)
+ *        only computes the unfinished blocks.  The file is deleted
+ *        when the job ends.  See comum/checkpoint.h.  The blocks are
+ *        split evenly (TRAP_CALIBRATE is not used), and the result can
+ *        differ in the last bits from a run without checkpoints.  A
+ *        process that can't write its record (e.g. the disk is full)
+ *        prints a warning and stops checkpointing.
+ *   10.  "Elapsed time" runs from the start to the end, including the
+ *        wait for the input.  It is followed by a table of the phases
+ *        with the min, avg and max over the processes:
+ *           input    reading the input, the broadcasts and a barrier
+ *           compute  calibration and Trap (or the cache/checkpoint)
+ *           reduce   the MPI_Reduce of the result, including the wait
+ *                    for the slowest process
+ *        and the load imbalance, max/avg of the compute times (1 is
+ *        perfect balance).  To fit compute scaling use the compute
+ *        (and reduce) times, not the elapsed time.  With the cache the
+ *        reductions are part of compute.
+ *   11.  If the environment variable TRAP_BATCH is set (on process 0),
+ *        the input is a list of jobs, one "a b n" per line, integrated
+ *        one after the other with the integrand of the command line.
+ *        The reduction of job k is posted with MPI_Ireduce and the
+ *        processes go on to job k+1 at once;  at most TRAP_BATCH
+ *        reductions are outstanding (BATCH_WINDOW if the value isn't
+ *        a number, blocking MPI_Reduce if it is 0).  Process 0 prints
+ *        the results in job order as they complete, then the total
+ *        time and the longest time a process spent waiting for
+ *        reductions.  The cache, checkpoints and calibration are not
+ *        used in this mode.
+ *   12.  If the environment variable TRAP_FARM is set (on process 0),
+ *        the input is a list of jobs as in note 11, but the jobs run
+ *        side by side:  MPI_COMM_WORLD is split (MPI_Comm_split) into
+ *        TRAP_FARM groups (one per job, up to one per process, if the
+ *        value isn't a positive number), and each group integrates
+ *        one job at a time with Trap and a reduction on its own
+ *        communicator.  The jobs are handed out in order of decreasing
+ *        cost (n times the nodes per panel):  the first job of each
+ *        group fixes its size, which is in proportion to that job's
+ *        cost, and when a group is done its leader takes the next job
+ *        from a counter in an MPI window on process 0.  Many jobs of
+ *        medium size then don't pay for a synchronization of every
+ *        process per job.  Process 0 prints the results in job order
+ *        with the group that ran each, then the groups' sizes and busy
+ *        times.  TRAP_FARM takes precedence over TRAP_BATCH;  the
+ *        cache, checkpoints and calibration are not used.
  *
  * IPP:   Section 3.5 (pp. 117 and ff.)
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "../../comum/integrands.h"
+#include "../../comum/expr.h"
+#include "../../comum/quad_rules.h"
+#include "../../comum/summation.h"
+#include "../../comum/partition.h"
+#include "../../comum/trap_cache.h"
+#include "../../comum/checkpoint.h"
+
+#define CALIB_PANELS (1L << 20)   /* Default panels per calibration run */
+#define BATCH_WINDOW 8            /* Default outstanding reductions      */
+#define MAX_LINE     256
+
+enum {PHASE_INPUT, PHASE_COMPUTE, PHASE_REDUCE, PHASE_COUNT};
+static const char* phase_names[PHASE_COUNT] = {"input", "compute", "reduce"};
 
 void Build_mpi_type(double* a_p, double* b_p, long int* n_p,
       MPI_Datatype* input_mpi_t_p);
 
 void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p,
-      long int* n_p);
+      long int* n_p, expr_prog_t* prog_p);
 
 double Trap(double left_endpt, double right_endpt, long int trap_count, 
-   double base_len);    
+   double base_len, const integrand_t* fn, const quad_rule_t* rule);
+void Trap_repro(double a, double h, long int n, part_t part,
+   const integrand_t* fn, const quad_rule_t* rule, repro_t* acc);    
+
+double Cached_trap(const char* dir, double a, double b, long int n,
+      const integrand_t* fn, int mode, int my_rank, int comm_sz,
+      char* status);
+
+part_t Calibrated_partition(double a, double b, long int n, long int calib,
+      const integrand_t* fn, const quad_rule_t* rule, long int align,
+      int my_rank, int comm_sz, double* min_rate_p, double* max_rate_p);
 
-double f(double x); 
+double Checkpointed_trap(const char* path, double a, double b, long int n,
+      const integrand_t* fn, const quad_rule_t* rule, int mode, int my_rank,
+      int comm_sz, char* status);
 
-int main(void) {
+void Print_phases(const double phase_time[], int my_rank, int comm_sz);
+
+long int Read_jobs(int my_rank, double** a_p, double** b_p, long int** n_p);
+void Batch_trap(int window, const integrand_t* fn, const quad_rule_t* rule,
+      int mode, int my_rank, int comm_sz);
+double Group_trap(double a, double b, long int n, const integrand_t* fn,
+      const quad_rule_t* rule, int mode, MPI_Comm comm);
+int Compare_jobs(const void* p, const void* q);
+void Farm_trap(int groups, const integrand_t* fn, const quad_rule_t* rule,
+      int mode, int my_rank, int comm_sz);
+
+int main(int argc, char* argv[]) {
    int my_rank, comm_sz;   
    double a, b, h, local_a, local_b;
    double local_int, total_int, local_start, local_finish, local_elapsed, elapsed;
-   long int n, local_n;
+   long int n;
+   part_t part;
+   const integrand_t* fn;   /* Function we're integrating */
+   expr_prog_t prog;        /* Formula typed in, if any   */
+   const quad_rule_t* rule; /* Rule applied to each panel */
+   int mode;                /* Summation mode             */
+   integrand_t fn_copy;     /* fn with mode's trap_sum    */
+   const char* cache_dir = NULL;  /* $TRAP_CACHE on process 0 */
+   int use_cache = 0;
+   char cache_status[64];
+   const char* calib_env;
+   long int calib = 0;      /* Calibration panels, 0 if off */
+   double min_rate, max_rate;
+   char ckpt_path[CKPT_PATH] = "";  /* $TRAP_CHECKPOINT, "" if off */
+   char ckpt_status[64];
+   double phase_start, phase_time[PHASE_COUNT];
+   const char* batch_env;
+   const char* farm_env;
+   char* end;
+   int window = -1;         /* Batch window, -1 if not batch */
+   int groups = -1;         /* Farm groups, -1 if not farm   */
+   long int align;          /* Partition unit               */
+   repro_t local_repro = REPRO_ZERO;
 
+#  ifdef _OPENMP
+   int provided;
 
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+#  else
    MPI_Init(NULL, NULL);
+#  endif
    MPI_Barrier(MPI_COMM_WORLD);
    local_start = MPI_Wtime();
 
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+#  ifdef _OPENMP
+   if (my_rank == 0 && provided < MPI_THREAD_FUNNELED)
+      fprintf(stderr, "Warning: MPI_THREAD_FUNNELED is not supported\n");
+#  endif
 
-   Get_input(my_rank, comm_sz, &a, &b, &n);
+   fn = Integrand_find(argc > 1 ? argv[1] : NULL);
+   rule = Rule_find(argc > 2 ? argv[2] : NULL);
+   mode = Sum_mode_find(argc > 3 ? argv[3] : NULL);
+   if (fn == NULL || rule == NULL || mode == SUM_BAD_MODE) {
+      if (my_rank == 0) {
+         fprintf(stderr,
+               "usage: mpiexec -n <p> %s [integrand [rule [summation]]]\n",
+               argv[0]);
+         Integrand_list(stderr);
+         Rule_list(stderr);
+         Sum_mode_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
 
-   h = (b-a)/n;          
-   local_n = n/comm_sz;  
+   if (my_rank == 0 && (farm_env = getenv("TRAP_FARM")) != NULL) {
+      groups = strtol(farm_env, &end, 10);
+      if (end == farm_env || groups < 1) groups = 0;
+   }
+   MPI_Bcast(&groups, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (groups >= 0) {
+      Farm_trap(groups, Sum_integrand(fn, mode, &fn_copy), rule, mode,
+            my_rank, comm_sz);
+      MPI_Finalize();
+      return 0;
+   }
 
+   if (my_rank == 0 && (batch_env = getenv("TRAP_BATCH")) != NULL) {
+      window = strtol(batch_env, &end, 10);
+      if (end == batch_env || window < 0) window = BATCH_WINDOW;
+   }
+   MPI_Bcast(&window, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (window >= 0) {
+      Batch_trap(window, Sum_integrand(fn, mode, &fn_copy), rule, mode,
+            my_rank, comm_sz);
+      MPI_Finalize();
+      return 0;
+   }
 
-   local_a = a + my_rank*local_n*h;
-   local_b = local_a + local_n*h;
-   local_int = Trap(local_a, local_b, local_n, h);
+   Get_input(my_rank, comm_sz, &a, &b, &n, &prog);
+   if (prog.n_instr == EXPR_BAD_PROGRAM) {
+      MPI_Finalize();
+      return 0;
+   }
+   if (prog.n_instr != EXPR_NO_PROGRAM) fn = Expr_integrand(&prog);
+   fn = Sum_integrand(fn, mode, &fn_copy);
 
-   MPI_Reduce(&local_int, &total_int, 1, MPI_DOUBLE, MPI_SUM, 0,
-         MPI_COMM_WORLD);
+   if (my_rank == 0) {
+      cache_dir = getenv("TRAP_CACHE");
+      use_cache = cache_dir != NULL && strcmp(rule->name, "trap") == 0
+         && mode != SUM_REPRO;
+      calib_env = getenv("TRAP_CALIBRATE");
+      if (calib_env != NULL) {
+         calib = strtol(calib_env, NULL, 10);
+         if (calib <= 0) calib = CALIB_PANELS;
+      }
+      if (getenv("TRAP_CHECKPOINT") != NULL)
+         snprintf(ckpt_path, CKPT_PATH, "%s", getenv("TRAP_CHECKPOINT"));
+   }
+   MPI_Bcast(&use_cache, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   MPI_Bcast(&calib, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+   MPI_Bcast(ckpt_path, CKPT_PATH, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   phase_time[PHASE_INPUT] = MPI_Wtime() - local_start;
+
+   phase_start = MPI_Wtime();
+   if (use_cache) {
+      total_int = Cached_trap(cache_dir, a, b, n, fn, mode, my_rank, comm_sz,
+            cache_status);
+   } else if (ckpt_path[0] != '\0') {
+      local_int = Checkpointed_trap(ckpt_path, a, b, n, fn, rule, mode,
+            my_rank, comm_sz, ckpt_status);
+   } else {
+      h = (b-a)/n;          
+      align = (mode == SUM_REPRO) ? REPRO_BLOCK : PART_ALIGN;
+      if (calib > 0)
+         part = Calibrated_partition(a, b, n, calib, fn, rule, align,
+               my_rank, comm_sz, &min_rate, &max_rate);
+      else
+         part = Partition(n, my_rank, comm_sz, align);
+
+      if (mode == SUM_REPRO) {
+         Trap_repro(a, h, n, part, fn, rule, &local_repro);
+      } else {
+         local_a = Part_left(a, h, part);
+         local_b = Part_right(a, h, part);
+         local_int = Trap(local_a, local_b, part.count, h, fn, rule);
+      }
+   }
+   phase_time[PHASE_COMPUTE] = MPI_Wtime() - phase_start;
+
+   phase_start = MPI_Wtime();
+   if (!use_cache) {
+      if (mode == SUM_PLAIN)
+         MPI_Reduce(&local_int, &total_int, 1, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+      else if (mode == SUM_REPRO && ckpt_path[0] == '\0')
+         total_int = Repro_reduce(&local_repro, 0, MPI_COMM_WORLD);
+      else
+         total_int = Sum2_reduce(local_int, 0, MPI_COMM_WORLD);
+   }
+   phase_time[PHASE_REDUCE] = MPI_Wtime() - phase_start;
+   /* Every process is done with the file once the reduction is */
+   if (ckpt_path[0] != '\0' && !use_cache && my_rank == 0)
+      remove(ckpt_path);
 
    if (my_rank == 0) {
-      printf("With n = %ld trapezoids, our estimate\n", n);
+      printf("f(x) = %s\n", fn->formula);
+      printf("With n = %ld %s, our estimate\n", n, rule->panels);
       printf("of the integral from %f to %f = %.15e\n",
          a, b, total_int);
    }
@@ -80,7 +347,20 @@ int main(void) {
 
    if (my_rank == 0) {
       printf("Elapsed time = %.4f\n", elapsed);
+      printf("SIMD kernel: %s\n", Trap_simd_isa_name());
+      printf("Summation: %s\n", sum_mode_names[mode]);
+      if (use_cache) printf("Cache: %s\n", cache_status);
+      if (ckpt_path[0] != '\0' && !use_cache)
+         printf("Checkpoint: %s\n", ckpt_status);
+      if (calib > 0 && !use_cache && ckpt_path[0] == '\0')
+         printf("Calibration: %ld panels, rates %.3e to %.3e panels/s\n",
+               calib, min_rate, max_rate);
+#     ifdef _OPENMP
+      printf("Processes x threads = %d x %d\n", comm_sz,
+            omp_get_max_threads());
+#     endif
    }
+   Print_phases(phase_time, my_rank, comm_sz);
 
    MPI_Finalize();
 
@@ -120,29 +400,38 @@ void Build_mpi_type(
 
 /*------------------------------------------------------------------
  * Function:     Get_input
- * Purpose:      Get the user input:  the left and right endpoints
- *               and the number of trapezoids
+ * Purpose:      Get the user input:  the left and right endpoints,
+ *               the number of trapezoids and, optionally, the
+ *               formula of f(x)
  * Input args:   my_rank:  process rank in MPI_COMM_WORLD
  *               comm_sz:  number of processes in MPI_COMM_WORLD
  * Output args:  a_p:  pointer to left endpoint               
  *               b_p:  pointer to right endpoint               
  *               n_p:  pointer to number of trapezoids
+ *               prog_p:  the compiled formula (n_instr is
+ *                  EXPR_NO_PROGRAM if there was none and
+ *                  EXPR_BAD_PROGRAM if it has an error)
  */
 void Get_input(
       int      my_rank  /* in  */, 
       int      comm_sz  /* in  */, 
       double*  a_p      /* out */, 
       double*  b_p      /* out */,
-      long int*     n_p      /* out */) {
+      long int*     n_p      /* out */,
+      expr_prog_t*  prog_p   /* out */) {
    MPI_Datatype input_mpi_t;
+   char err[EXPR_MAX_TEXT];
 
    Build_mpi_type(a_p, b_p, n_p, &input_mpi_t);
 
    if (my_rank == 0) {
-      printf("Enter a, b, and n\n");
+      printf("Enter a, b, and n [and f(x)]\n");
       scanf("%lf %lf %ld", a_p, b_p, n_p);
+      if (!Expr_read(stdin, prog_p, err))
+         fprintf(stderr, "f(x): %s\n", err);
    } 
    MPI_Bcast(a_p, 1, input_mpi_t, 0, MPI_COMM_WORLD);
+   Expr_bcast(prog_p, 0, MPI_COMM_WORLD);
 
    MPI_Type_free(&input_mpi_t);
 }  /* Get_input */
@@ -150,39 +439,686 @@ void Get_input(
 /*------------------------------------------------------------------
  * Function:     Trap
  * Purpose:      Serial function for estimating a definite integral 
- *               using the trapezoidal rule
+ *               using the trapezoidal rule (or another rule)
+ * Note:         The samples are summed by fn->trap_sum.  In the
+ *               hybrid version the panels are split among the
+ *               threads of a parallel region, and the last thread
+ *               ends at right_endpt
  * Input args:   left_endpt
  *               right_endpt
  *               trap_count 
  *               base_len
- * Return val:   Trapezoidal rule estimate of integral from
- *               left_endpt to right_endpt using trap_count
- *               trapezoids
+ *               fn
+ *               rule
+ * Return val:   Estimate of integral from left_endpt to right_endpt
+ *               using trap_count panels of the rule
  */
 double Trap(
       double left_endpt  /* in */, 
       double right_endpt /* in */, 
       long int    trap_count  /* in */, 
-      double base_len    /* in */) {
-   double estimate, x; 
-   long int i;
+      double base_len    /* in */,
+      const integrand_t* fn /* in */,
+      const quad_rule_t* rule /* in */) {
+#  ifdef _OPENMP
+   double estimate = 0.0;
 
-   estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
-   estimate = estimate*base_len;
+#  pragma omp parallel default(none) \
+      shared(left_endpt, right_endpt, trap_count, base_len, fn, rule) \
+      reduction(+: estimate)
+   {
+      part_t part = Partition(trap_count, omp_get_thread_num(),
+            omp_get_num_threads(), PART_ALIGN);
+      double my_right = (part.first + part.count == trap_count)
+         ? right_endpt : Part_right(left_endpt, base_len, part);
 
+      estimate += Rule_panels(rule, fn, Part_left(left_endpt, base_len, part),
+            my_right, part.count, base_len);
+   }
    return estimate;
+#  else
+   return Rule_panels(rule, fn, left_endpt, right_endpt, trap_count,
+         base_len);
+#  endif
 } /*  Trap  */
 
+/*------------------------------------------------------------------
+ * Function:     Trap_repro
+ * Purpose:      This process' part of the rule in the repro summation
+ *               mode, added to an exact accumulator
+ * Input args:   a, h, n:  the whole integral (the samples are taken
+ *                  on the global grid)
+ *               part:  this process' panels, starting on a multiple
+ *                  of REPRO_BLOCK
+ *               fn, rule
+ * In/out arg:   acc
+ * Note:         In the hybrid version the threads split part in
+ *               whole blocks and their accumulators are combined by
+ *               a reduction(repro)
+ */
+void Trap_repro(
+      double       a        /* in */,
+      double       h        /* in */,
+      long int     n        /* in */,
+      part_t       part     /* in */,
+      const integrand_t* fn /* in */,
+      const quad_rule_t* rule /* in */,
+      repro_t*     acc      /* in/out */) {
+#  ifdef _OPENMP
+   repro_t total = REPRO_ZERO;
+
+#  pragma omp parallel default(none) shared(a, h, n, part, fn, rule) \
+      reduction(repro: total)
+   {
+      part_t mine = Partition(part.count, omp_get_thread_num(),
+            omp_get_num_threads(), REPRO_BLOCK);
+
+      mine.first += part.first;
+      Rule_panels_repro(&total, rule, fn, a, h, n, mine);
+   }
+   Repro_merge(acc, &total);
+#  else
+   Rule_panels_repro(acc, rule, fn, a, h, n, part);
+#  endif
+} /*  Trap_repro  */
+
+/*------------------------------------------------------------------
+ * Function:     Calibrated_partition
+ * Purpose:      Time a short run of Trap on each process, gather the
+ *               rates and find this process' share of the n panels
+ *               in proportion to its rate
+ * Input args:   a, b, n, fn, rule, my_rank, comm_sz
+ *               calib:  panels in the calibration run
+ *               align:  unit of the partition
+ * Output args:  min_rate_p, max_rate_p:  slowest and fastest rates,
+ *                  in panels per second
+ * Return val:   this process' panels
+ * Note:         The run is made on the process' panels of the even
+ *               partition, squeezed into calib panels, so the cost of
+ *               f where the process mostly works is what's timed.
+ *               The best of two runs is kept.
+ */
+part_t Calibrated_partition(
+      double       a        /* in  */,
+      double       b        /* in  */,
+      long int     n        /* in  */,
+      long int     calib    /* in  */,
+      const integrand_t* fn /* in  */,
+      const quad_rule_t* rule /* in  */,
+      long int     align    /* in  */,
+      int          my_rank  /* in  */,
+      int          comm_sz  /* in  */,
+      double*      min_rate_p /* out */,
+      double*      max_rate_p /* out */) {
+   part_t even = Partition(n, my_rank, comm_sz, align);
+   double h = (b-a)/n, left, right, start, elapsed, best = 0.0, rate;
+   double rates[comm_sz];
+   volatile double sink;
+   int run, q;
+
+   left = Part_left(a, h, even);
+   right = Part_right(a, h, even);
+   if (even.count == 0) right = left + h;
+   for (run = 0; run < 2; run++) {
+      start = MPI_Wtime();
+      sink = Trap(left, right, calib, (right - left)/calib, fn, rule);
+      elapsed = MPI_Wtime() - start;
+      if (run == 0 || elapsed < best) best = elapsed;
+   }
+   (void) sink;
+   if (best <= 0.0) best = 1.0e-9;
+   rate = calib/best;
+
+   MPI_Allgather(&rate, 1, MPI_DOUBLE, rates, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+   *min_rate_p = *max_rate_p = rates[0];
+   for (q = 1; q < comm_sz; q++) {
+      if (rates[q] < *min_rate_p) *min_rate_p = rates[q];
+      if (rates[q] > *max_rate_p) *max_rate_p = rates[q];
+   }
+
+   return Weighted_partition(n, my_rank, comm_sz, rates, align);
+}  /* Calibrated_partition */
+
+/*------------------------------------------------------------------
+ * Function:     Cached_trap
+ * Purpose:      Trapezoidal rule using the cache in dir:  process 0
+ *               reads the cache entry, the processes share the new
+ *               samples of each missing level, and process 0 adds up
+ *               their sums of each part and writes the entry back
+ * Input args:   dir (process 0 only), a, b, n, fn, mode, my_rank,
+ *               comm_sz
+ * Output arg:   status:  what the cache did (process 0 only)
+ * Return val:   estimate of integral from a to b of f(x) on process 0
+ */
+double Cached_trap(
+      const char*  dir      /* in  */,
+      double       a        /* in  */,
+      double       b        /* in  */,
+      long int     n        /* in  */,
+      const integrand_t* fn /* in  */,
+      int          mode     /* in  */,
+      int          my_rank  /* in  */,
+      int          comm_sz  /* in  */,
+      char*        status   /* out */) {
+   trap_cache_t cache;
+   double my_sum[CACHE_PARTS], part_sum[CACHE_PARTS];
+   int level, k, found = 0, last = Cache_level(n);
+   part_t mine;
+
+   if (my_rank == 0)
+      found = Cache_load(dir, fn, mode, a, b, n, &cache);
+   MPI_Bcast(&cache, sizeof(trap_cache_t), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      if (cache.level >= last)
+         sprintf(status, "hit");
+      else if (found)
+         sprintf(status, "refined from n = %ld", cache.n_odd << cache.level);
+      else
+         sprintf(status, "new entry");
+   }
+   if (cache.level >= last)
+      return my_rank == 0 ? Cache_estimate(&cache, fn, n) : 0.0;
+
+   for (level = cache.level + 1; level <= last; level++) {
+      mine = Partition(Cache_new_samples(&cache, level), my_rank, comm_sz,
+            PART_ALIGN);
+      for (k = 0; k < CACHE_PARTS; k++)
+         my_sum[k] = 0.0;
+#     ifdef _OPENMP
+#     pragma omp parallel default(none) shared(cache, fn, level, mine) \
+         reduction(+: my_sum)
+      {
+         part_t my_thread = Partition(mine.count, omp_get_thread_num(),
+               omp_get_num_threads(), PART_ALIGN);
+
+         Cache_range_sums(&cache, fn, level, mine.first + my_thread.first,
+               my_thread.count, my_sum);
+      }
+#     else
+      Cache_range_sums(&cache, fn, level, mine.first, mine.count, my_sum);
+#     endif
+      MPI_Reduce(my_sum, part_sum, cache.parts, MPI_DOUBLE, MPI_SUM, 0,
+            MPI_COMM_WORLD);
+      if (my_rank == 0) Cache_add_level(&cache, fn, level, part_sum);
+   }
+
+   if (my_rank != 0) return 0.0;
+   if (!Cache_save(dir, &cache))
+      fprintf(stderr, "Can't write the cache entry in %s\n", dir);
+   return Cache_estimate(&cache, fn, n);
+}  /* Cached_trap */
+
+/*------------------------------------------------------------------
+ * Function:     Checkpointed_trap
+ * Purpose:      Estimate the integral block by block, skipping the
+ *               blocks finished in the checkpoint file at path and
+ *               writing each block as it's finished
+ * Input args:   path, a, b, n, fn, rule, mode, my_rank, comm_sz
+ * Output arg:   status:  what the checkpoint did (process 0 only)
+ * Return val:   this process' part of the estimate (on process 0 it
+ *               includes the blocks finished before the restart)
+ */
+double Checkpointed_trap(
+      const char*  path     /* in  */,
+      double       a        /* in  */,
+      double       b        /* in  */,
+      long int     n        /* in  */,
+      const integrand_t* fn /* in  */,
+      const quad_rule_t* rule /* in  */,
+      int          mode     /* in  */,
+      int          my_rank  /* in  */,
+      int          comm_sz  /* in  */,
+      char*        status   /* out */) {
+   ckpt_header_t key;
+   ckpt_record_t* records;
+   long int k, i, todo = 0, *undone;
+   int fd = -1, resumed = 0, ok = 1;
+   double h = (b-a)/n, last_sync;
+   sum2_t local = SUM2_ZERO;
+   part_t mine, block;
+
+   Ckpt_key(&key, fn->formula, rule->name, mode, a, b, n);
+   records = malloc(key.blocks*sizeof(ckpt_record_t));
+   undone = malloc(key.blocks*sizeof(long int));
+
+   if (my_rank == 0) {
+      fd = Ckpt_open(path, &key, records, &resumed);
+      if (fd < 0) {
+         fprintf(stderr, "Can't open the checkpoint %s\n", path);
+         memset(records, 0, key.blocks*sizeof(ckpt_record_t));
+         ok = 0;
+      }
+   }
+   MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   MPI_Bcast(records, key.blocks*sizeof(ckpt_record_t), MPI_BYTE, 0,
+         MPI_COMM_WORLD);
+   if (my_rank != 0 && ok) fd = open(path, O_WRONLY);
+
+   /* Blocks finished before the restart are added by process 0 */
+   for (k = 0; k < key.blocks; k++)
+      if (!records[k].done)
+         undone[todo++] = k;
+      else if (my_rank == 0)
+         Sum2_add(&local, records[k].sum);
+   if (my_rank == 0) {
+      if (!ok)
+         sprintf(status, "not used");
+      else if (resumed)
+         sprintf(status, "resumed, %ld of %ld blocks were done",
+               key.blocks - todo, key.blocks);
+      else
+         sprintf(status, "new, %ld blocks", key.blocks);
+   }
+
+   mine = Partition(todo, my_rank, comm_sz, 1);
+   last_sync = MPI_Wtime();
+   for (i = mine.first; i < mine.first + mine.count; i++) {
+      k = undone[i];
+      block = Ckpt_block(&key, k);
+      records[k].sum = Trap(Part_left(a, h, block), Part_right(a, h, block),
+            block.count, h, fn, rule);
+      records[k].done = 1;
+      Sum2_add(&local, records[k].sum);
+      if (fd >= 0) {
+         if (!Ckpt_write(fd, k, &records[k])) {
+            /* A restart just redoes this process' unrecorded blocks */
+            fprintf(stderr, "Process %d: can't write the checkpoint %s, "
+                  "going on without it\n", my_rank, path);
+            close(fd);
+            fd = -1;
+         } else if (MPI_Wtime() - last_sync > CKPT_SYNC_SECONDS) {
+            fdatasync(fd);
+            last_sync = MPI_Wtime();
+         }
+      }
+   }
+
+   if (fd >= 0) close(fd);
+   free(undone);
+   free(records);
+   return Sum2_value(local);
+}  /* Checkpointed_trap */
 
 /*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input args:  x
+ * Function:     Print_phases
+ * Purpose:      Print the min, avg and max over the processes of the
+ *               time of each phase, and the load imbalance of compute
+ * Input args:   phase_time:  this process' times, PHASE_COUNT of them
+ *               my_rank, comm_sz
  */
-double f(double x /* in */) {
-   return x*x;
-} /* f */
+void Print_phases(
+      const double phase_time[] /* in  */,
+      int          my_rank      /* in  */,
+      int          comm_sz      /* in  */) {
+   double min[PHASE_COUNT], max[PHASE_COUNT], sum[PHASE_COUNT], avg;
+   int p;
+
+   MPI_Reduce(phase_time, min, PHASE_COUNT, MPI_DOUBLE, MPI_MIN, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(phase_time, max, PHASE_COUNT, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(phase_time, sum, PHASE_COUNT, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   if (my_rank != 0) return;
+
+   printf("%-8s %10s %10s %10s\n", "phase", "min", "avg", "max");
+   for (p = 0; p < PHASE_COUNT; p++)
+      printf("%-8s %10.4f %10.4f %10.4f\n", phase_names[p], min[p],
+            sum[p]/comm_sz, max[p]);
+   avg = sum[PHASE_COMPUTE]/comm_sz;
+   printf("Load imbalance (max/avg compute) = %.3f\n",
+         avg > 0.0 ? max[PHASE_COMPUTE]/avg : 1.0);
+}  /* Print_phases */
+
+/*------------------------------------------------------------------
+ * Function:     Read_jobs
+ * Purpose:      Read the jobs ("a b n" per line, blank lines and lines
+ *               starting with # skipped) on process 0 and broadcast
+ *               them
+ * Output args:  a_p, b_p, n_p:  arrays of the jobs (malloc'ed)
+ * Return val:   number of jobs
+ */
+long int Read_jobs(
+      int        my_rank  /* in  */,
+      double**   a_p      /* out */,
+      double**   b_p      /* out */,
+      long int** n_p      /* out */) {
+   char line[MAX_LINE];
+   long int count = 0, cap = 0;
+   double a, b;
+   long int n;
+
+   *a_p = *b_p = NULL;
+   *n_p = NULL;
+   if (my_rank == 0) {
+      printf("Enter one job (a b n) per line\n");
+      while (fgets(line, MAX_LINE, stdin) != NULL) {
+         if (strspn(line, " \t\r\n") == strlen(line) || line[0] == '#')
+            continue;
+         if (sscanf(line, "%lf %lf %ld", &a, &b, &n) != 3 || n < 1) {
+            fprintf(stderr, "Skipping bad job: %s", line);
+            continue;
+         }
+         if (count == cap) {
+            cap = 2*cap + 64;
+            *a_p = realloc(*a_p, cap*sizeof(double));
+            *b_p = realloc(*b_p, cap*sizeof(double));
+            *n_p = realloc(*n_p, cap*sizeof(long int));
+         }
+         (*a_p)[count] = a;
+         (*b_p)[count] = b;
+         (*n_p)[count] = n;
+         count++;
+      }
+   }
+
+   MPI_Bcast(&count, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+   if (my_rank != 0) {
+      *a_p = malloc((count > 0 ? count : 1)*sizeof(double));
+      *b_p = malloc((count > 0 ? count : 1)*sizeof(double));
+      *n_p = malloc((count > 0 ? count : 1)*sizeof(long int));
+   }
+   MPI_Bcast(*a_p, count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(*b_p, count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(*n_p, count, MPI_LONG, 0, MPI_COMM_WORLD);
+   return count;
+}  /* Read_jobs */
+
+/*------------------------------------------------------------------
+ * Function:     Batch_trap
+ * Purpose:      Integrate a list of jobs, overlapping the reduction of
+ *               each job with the computation of the next ones
+ * Input args:   window:  most reductions outstanding (0:  blocking)
+ *               fn, rule, mode, my_rank, comm_sz
+ * Note:         Job k uses slot k % window of the buffers;  before a
+ *               slot is reused its reduction is waited for and (on
+ *               process 0) its result printed, so the results come
+ *               out in job order.  After each job MPI_Testall gives
+ *               the MPI library a chance to progress the outstanding
+ *               reductions.
+ */
+void Batch_trap(
+      int          window   /* in  */,
+      const integrand_t* fn /* in  */,
+      const quad_rule_t* rule /* in  */,
+      int          mode     /* in  */,
+      int          my_rank  /* in  */,
+      int          comm_sz  /* in  */) {
+   double *a, *b, h, start, finish, t, wait = 0.0, max_wait;
+   long int *n, jobs, k, done = 0;
+   int slots = window > 0 ? window : 1, slot, flag;
+   sum2_t *local, *total;
+   MPI_Request* req;
+   MPI_Datatype sum2_mpi_t;
+   MPI_Op sum2_op;
+   part_t part;
+
+   jobs = Read_jobs(my_rank, &a, &b, &n);
+   local = malloc(slots*sizeof(sum2_t));
+   total = malloc(slots*sizeof(sum2_t));
+   req = malloc(slots*sizeof(MPI_Request));
+   for (slot = 0; slot < slots; slot++)
+      req[slot] = MPI_REQUEST_NULL;
+   Sum2_mpi_create(&sum2_mpi_t, &sum2_op);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   for (k = 0; k < jobs + slots; k++) {
+      /* Free the slot of job k:  finish job k - slots */
+      slot = k % slots;
+      if (k >= slots) {
+         t = MPI_Wtime();
+         MPI_Wait(&req[slot], MPI_STATUS_IGNORE);
+         wait += MPI_Wtime() - t;
+         if (my_rank == 0)
+            printf("%ld %f %f %ld %.15e\n", done, a[done], b[done],
+                  n[done], Sum2_value(total[slot]));
+         done++;
+      }
+      if (k >= jobs) continue;
+
+      h = (b[k] - a[k])/n[k];
+      part = Partition(n[k], my_rank, comm_sz, PART_ALIGN);
+      local[slot].s = Trap(Part_left(a[k], h, part),
+            Part_right(a[k], h, part), part.count, h, fn, rule);
+      local[slot].c = 0.0;
+      total[slot] = SUM2_ZERO;
+
+      if (window == 0) {
+         t = MPI_Wtime();
+         if (mode == SUM_PLAIN)
+            MPI_Reduce(&local[slot].s, &total[slot].s, 1, MPI_DOUBLE,
+                  MPI_SUM, 0, MPI_COMM_WORLD);
+         else
+            MPI_Reduce(&local[slot], &total[slot], 1, sum2_mpi_t, sum2_op,
+                  0, MPI_COMM_WORLD);
+         wait += MPI_Wtime() - t;
+      } else {
+         if (mode == SUM_PLAIN)
+            MPI_Ireduce(&local[slot].s, &total[slot].s, 1, MPI_DOUBLE,
+                  MPI_SUM, 0, MPI_COMM_WORLD, &req[slot]);
+         else
+            MPI_Ireduce(&local[slot], &total[slot], 1, sum2_mpi_t, sum2_op,
+                  0, MPI_COMM_WORLD, &req[slot]);
+         MPI_Testall(slots, req, &flag, MPI_STATUSES_IGNORE);
+      }
+   }
+   finish = MPI_Wtime();
+
+   MPI_Reduce(&wait, &max_wait, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+   if (my_rank == 0) {
+      printf("Batch: %ld jobs, %s, %s rule\n", jobs,
+            window == 0 ? "blocking reductions" : "window of reductions",
+            rule->name);
+      if (window > 0) printf("Window = %d\n", window);
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Max time waiting for reductions = %.4f\n", max_wait);
+   }
+
+   MPI_Op_free(&sum2_op);
+   MPI_Type_free(&sum2_mpi_t);
+   free(req);
+   free(total);
+   free(local);
+   free(n);
+   free(b);
+   free(a);
+}  /* Batch_trap */
+
+/*------------------------------------------------------------------
+ * Function:     Group_trap
+ * Purpose:      Integrate one job with the processes of comm
+ * Input args:   a, b, n, fn, rule, mode
+ *               comm:  the processes that share the job
+ * Return val:   on process 0 of comm, the integral;  on the others, 0
+ *               or a partial result
+ */
+double Group_trap(
+      double       a        /* in  */,
+      double       b        /* in  */,
+      long int     n        /* in  */,
+      const integrand_t* fn /* in  */,
+      const quad_rule_t* rule /* in  */,
+      int          mode     /* in  */,
+      MPI_Comm     comm     /* in  */) {
+   int my_rank, comm_sz;
+   double h = (b-a)/n, local_int, total_int = 0.0;
+   repro_t local_repro = REPRO_ZERO;
+   part_t part;
+
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Comm_size(comm, &comm_sz);
+   if (mode == SUM_REPRO) {
+      part = Partition(n, my_rank, comm_sz, REPRO_BLOCK);
+      Trap_repro(a, h, n, part, fn, rule, &local_repro);
+      return Repro_reduce(&local_repro, 0, comm);
+   }
+
+   part = Partition(n, my_rank, comm_sz, PART_ALIGN);
+   local_int = Trap(Part_left(a, h, part), Part_right(a, h, part),
+         part.count, h, fn, rule);
+   if (mode == SUM_PLAIN)
+      MPI_Reduce(&local_int, &total_int, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   else
+      total_int = Sum2_reduce(local_int, 0, comm);
+   return total_int;
+}  /* Group_trap */
+
+typedef struct {
+   double   cost;   /* Estimated cost:  nodes to evaluate */
+   long int job;    /* Index in the input                 */
+} farm_job_t;
+
+/*------------------------------------------------------------------
+ * Function:     Compare_jobs
+ * Purpose:      Order jobs by decreasing cost, then by input order.
+ *               Used by qsort.
+ */
+int Compare_jobs(const void* p, const void* q) {
+   const farm_job_t* x = p;
+   const farm_job_t* y = q;
+
+   if (x->cost != y->cost) return (x->cost < y->cost) ? 1 : -1;
+   return (x->job < y->job) ? -1 : (x->job > y->job);
+}  /* Compare_jobs */
+
+/*------------------------------------------------------------------
+ * Function:     Farm_trap
+ * Purpose:      Integrate a list of jobs concurrently, in groups of
+ *               processes that take jobs as they finish them
+ * Input args:   groups:  number of groups (0:  one per job, up to one
+ *                  per process)
+ *               fn, rule, mode, my_rank, comm_sz
+ * Note:         The jobs are sorted by decreasing cost, and job
+ *               order[g] is the first job of group g.  Every process
+ *               computes the same group sizes from the costs of these
+ *               first jobs (one process each, and the others dealt by
+ *               Weighted_partition), so no communication is needed to
+ *               split MPI_COMM_WORLD.  The counter in the window holds
+ *               the position in order[] of the next job not taken;  a
+ *               group's leader claims it with MPI_Fetch_and_op and
+ *               broadcasts it to the group, and a position >= jobs
+ *               means there is nothing left.
+ */
+void Farm_trap(
+      int          groups   /* in  */,
+      const integrand_t* fn /* in  */,
+      const quad_rule_t* rule /* in  */,
+      int          mode     /* in  */,
+      int          my_rank  /* in  */,
+      int          comm_sz  /* in  */) {
+   double *a, *b, *result, *all_result = NULL, *weight, *busy, *all_busy;
+   double start, finish, t, total_int, panels = 0.0;
+   long int *n, *ran_by, *all_ran_by = NULL, *ran, *all_ran;
+   long int jobs, k, next, one = 1, *counter;
+   int g, my_group = 0, group_rank, group_sz, *sizes;
+   farm_job_t* order;
+   part_t extra;
+   MPI_Comm group_comm;
+   MPI_Win win;
+
+   jobs = Read_jobs(my_rank, &a, &b, &n);
+   order = malloc((jobs > 0 ? jobs : 1)*sizeof(farm_job_t));
+   for (k = 0; k < jobs; k++) {
+      order[k].cost = (double) n[k]*rule->points;
+      order[k].job = k;
+      panels += n[k];
+   }
+   qsort(order, jobs, sizeof(farm_job_t), Compare_jobs);
+
+   if (groups == 0 || groups > jobs) groups = jobs;
+   if (groups > comm_sz) groups = comm_sz;
+   if (groups < 1) groups = 1;
+   weight = malloc(groups*sizeof(double));
+   sizes = malloc(groups*sizeof(int));
+   for (g = 0; g < groups; g++)
+      weight[g] = (g < jobs) ? order[g].cost : 0.0;
+   for (g = 0; g < groups; g++) {
+      extra = Weighted_partition(comm_sz - groups, g, groups, weight, 1);
+      sizes[g] = extra.count + 1;
+      if (my_rank >= extra.first + g) my_group = g;
+   }
+   MPI_Comm_split(MPI_COMM_WORLD, my_group, my_rank, &group_comm);
+   MPI_Comm_rank(group_comm, &group_rank);
+   MPI_Comm_size(group_comm, &group_sz);
+
+   MPI_Win_allocate(my_rank == 0 ? sizeof(long) : 0, sizeof(long),
+         MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win);
+   if (my_rank == 0) {
+      /* Local stores to a window need an access epoch too */
+      MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+      *counter = groups;
+      MPI_Win_unlock(0, win);
+   }
+   result = calloc(jobs > 0 ? jobs : 1, sizeof(double));
+   ran_by = calloc(jobs > 0 ? jobs : 1, sizeof(long int));
+   busy = calloc(groups, sizeof(double));
+   ran = calloc(groups, sizeof(long int));
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   MPI_Win_lock_all(0, win);
+   start = MPI_Wtime();
+   for (next = my_group; next < jobs; ) {
+      k = order[next].job;
+      t = MPI_Wtime();
+      total_int = Group_trap(a[k], b[k], n[k], fn, rule, mode, group_comm);
+      if (group_rank == 0) {
+         busy[my_group] += MPI_Wtime() - t;
+         ran[my_group]++;
+         result[k] = total_int;
+         ran_by[k] = my_group;
+         MPI_Fetch_and_op(&one, &next, MPI_LONG, 0, 0, MPI_SUM, win);
+         MPI_Win_flush(0, win);
+      }
+      MPI_Bcast(&next, 1, MPI_LONG, 0, group_comm);
+   }
+   MPI_Win_unlock_all(win);
+   MPI_Barrier(MPI_COMM_WORLD);
+   finish = MPI_Wtime();
+
+   /* Each job and each group's totals come from exactly one leader */
+   all_busy = malloc(groups*sizeof(double));
+   all_ran = malloc(groups*sizeof(long int));
+   if (my_rank == 0) {
+      all_result = malloc((jobs > 0 ? jobs : 1)*sizeof(double));
+      all_ran_by = malloc((jobs > 0 ? jobs : 1)*sizeof(long int));
+   }
+   MPI_Reduce(result, all_result, jobs, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(ran_by, all_ran_by, jobs, MPI_LONG, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(busy, all_busy, groups, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(ran, all_ran, groups, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      for (k = 0; k < jobs; k++)
+         printf("%ld %f %f %ld %.15e %ld\n", k, a[k], b[k], n[k],
+               all_result[k], all_ran_by[k]);
+      printf("Farm: %ld jobs, %d groups, %s rule\n", jobs, groups,
+            rule->name);
+      for (g = 0; g < groups; g++)
+         printf("Group %d: %d processes, %ld jobs, busy %.4f\n", g,
+               sizes[g], all_ran[g], all_busy[g]);
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Panels per second = %.3e\n", panels/(finish - start));
+      free(all_ran_by);
+      free(all_result);
+   }
+
+   MPI_Win_free(&win);
+   MPI_Comm_free(&group_comm);
+   free(all_ran);
+   free(all_busy);
+   free(ran);
+   free(busy);
+   free(ran_by);
+   free(result);
+   free(sizes);
+   free(weight);
+   free(order);
+   free(n);
+   free(b);
+   free(a);
+}  /* Farm_trap */
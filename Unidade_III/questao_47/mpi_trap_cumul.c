@@ -0,0 +1,313 @@
+/* File:     mpi_trap_cumul.c
+ * Purpose:  Use MPI (and OpenMP) to compute the running integral
+ *
+ *              F(x_i) = integral from a to x_i of f(x),  x_i = a + i*h
+ *
+ *           at every point of the grid with the trapezoidal rule (e.g.
+ *           for a table of a CDF or of arc length), and write the
+ *           table to a binary file.
+ *
+ * Input:    a, b, n
+ * Output:   The file named on the command line, with the n + 1 pairs
+ *           of doubles x_0 F_0 x_1 F_1 ... x_n F_n (in the machine's
+ *           byte order, no header:  the format of comum/tabulated.h,
+ *           so mpi_trap_table can read it).  On stdout F(b), its
+ *           error (if the primitive of f is known), the elapsed time
+ *           and the rate.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap_cumul mpi_trap_cumul.c -lm
+ *           hybrid MPI+OpenMP version:
+ *           mpicc -g -Wall -O2 -fopenmp -o mpi_trap_cumul_omp \
+ *              mpi_trap_cumul.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_trap_cumul <file>
+ *              [integrand]
+ *
+ * Algorithm:
+ *    The panels are done in rounds of comm_sz*CUMUL_CHUNK panels;  in
+ *    each round every process gets a piece of about CUMUL_CHUNK
+ *    panels (comum/partition.h), so the memory used doesn't depend
+ *    on n.  For each round:
+ *    1.  Each thread evaluates f at its points of the piece and adds
+ *        up the areas of its panels.
+ *    2.  The process adds its threads' totals, and MPI_Exscan of the
+ *        pieces' totals gives the integral up to the start of its
+ *        piece (plus the totals of the earlier rounds, from an
+ *        MPI_Allreduce).
+ *    3.  Each thread starts from that value plus the totals of the
+ *        threads before it, and computes the running sums of its
+ *        panels.
+ *    4.  The piece is written to the file with MPI_File_iwrite_at,
+ *        which overlaps with the next round (two buffers).
+ *
+ * Notes:
+ *    1.  f is evaluated once per point:  the table costs about the
+ *        same as one integration, plus the writing.
+ *    2.  The running sums, the threads' totals and the reductions are
+ *        compensated (comum/summation.h), so F(x_i) doesn't drift over
+ *        billions of panels.
+ *    3.  In the hybrid version MPI is initialized with
+ *        MPI_THREAD_FUNNELED:  only the master thread calls MPI.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "../../comum/integrands.h"
+#include "../../comum/summation.h"
+#include "../../comum/partition.h"
+
+#define CUMUL_CHUNK  (1L << 20)   /* Panels per process per round */
+#define MAX_THREADS  1024
+
+void Get_input(int my_rank, double* a_p, double* b_p, long int* n_p);
+void Piece_totals(const integrand_t* fn, double a, double h, part_t piece,
+      double y[], sum2_t thread_total[], int* threads_p);
+void Piece_scan(double a, double h, part_t piece, const double y[],
+      const sum2_t thread_total[], sum2_t base, double out[]);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, threads, t, buf = 0;
+   double a, b, h, start, finish, exact, *y, *out[2], first_pair[2];
+   long int n, round, rounds, round_first, round_count;
+   part_t piece;
+   const integrand_t* fn;
+   sum2_t thread_total[MAX_THREADS], piece_total, before, round_total;
+   sum2_t carry = SUM2_ZERO, base;
+   MPI_Datatype sum2_mpi_t;
+   MPI_Op sum2_op;
+   MPI_File file;
+   MPI_Request req[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+#  ifdef _OPENMP
+   int provided;
+
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+#  else
+   MPI_Init(NULL, NULL);
+#  endif
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+#  ifdef _OPENMP
+   if (omp_get_max_threads() > MAX_THREADS)
+      omp_set_num_threads(MAX_THREADS);
+#  endif
+
+   fn = Integrand_find(argc > 2 ? argv[2] : NULL);
+   if (argc < 2 || argc > 3 || fn == NULL) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s <file> [integrand]\n",
+               argv[0]);
+         Integrand_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+   if (MPI_File_open(MPI_COMM_WORLD, argv[1],
+            MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file)
+         != MPI_SUCCESS) {
+      if (my_rank == 0) fprintf(stderr, "Can't open %s\n", argv[1]);
+      MPI_Finalize();
+      return 0;
+   }
+
+   Get_input(my_rank, &a, &b, &n);
+   h = (b-a)/n;
+   y = malloc((CUMUL_CHUNK + PART_ALIGN + 1)*sizeof(double));
+   out[0] = malloc(2*(CUMUL_CHUNK + PART_ALIGN)*sizeof(double));
+   out[1] = malloc(2*(CUMUL_CHUNK + PART_ALIGN)*sizeof(double));
+   Sum2_mpi_create(&sum2_mpi_t, &sum2_op);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   MPI_File_set_size(file, (MPI_Offset) (n + 1)*2*sizeof(double));
+   if (my_rank == 0) {
+      first_pair[0] = a;
+      first_pair[1] = 0.0;
+      MPI_File_write_at(file, 0, first_pair, 2, MPI_DOUBLE,
+            MPI_STATUS_IGNORE);
+   }
+
+   rounds = (n + comm_sz*CUMUL_CHUNK - 1)/(comm_sz*CUMUL_CHUNK);
+   for (round = 0; round < rounds; round++) {
+      round_first = round*comm_sz*CUMUL_CHUNK;
+      round_count = (n - round_first < comm_sz*CUMUL_CHUNK)
+         ? n - round_first : comm_sz*CUMUL_CHUNK;
+      piece = Partition(round_count, my_rank, comm_sz, PART_ALIGN);
+      piece.first += round_first;
+
+      /* Pass 1:  totals of the threads and of the piece */
+      Piece_totals(fn, a, h, piece, y, thread_total, &threads);
+      piece_total = SUM2_ZERO;
+      for (t = 0; t < threads; t++)
+         Sum2_merge(&piece_total, &thread_total[t]);
+
+      /* Integral up to my piece:  earlier rounds + earlier processes */
+      before = SUM2_ZERO;
+      MPI_Exscan(&piece_total, &before, 1, sum2_mpi_t, sum2_op,
+            MPI_COMM_WORLD);
+      if (my_rank == 0) before = SUM2_ZERO;
+      MPI_Allreduce(&piece_total, &round_total, 1, sum2_mpi_t, sum2_op,
+            MPI_COMM_WORLD);
+      base = carry;
+      Sum2_merge(&base, &before);
+      Sum2_merge(&carry, &round_total);
+
+      /* Pass 2:  running sums, written while the next round runs */
+      MPI_Wait(&req[buf], MPI_STATUS_IGNORE);
+      Piece_scan(a, h, piece, y, thread_total, base, out[buf]);
+      if (piece.count > 0)
+         MPI_File_iwrite_at(file,
+               (MPI_Offset) (piece.first + 1)*2*sizeof(double), out[buf],
+               2*piece.count, MPI_DOUBLE, &req[buf]);
+      buf = 1 - buf;
+   }
+   MPI_Waitall(2, req, MPI_STATUSES_IGNORE);
+   MPI_File_close(&file);
+   finish = MPI_Wtime();
+
+   if (my_rank == 0) {
+      printf("f(x) = %s\n", fn->formula);
+      printf("With n = %ld trapezoids, the integral from %f to %f\n",
+            n, a, b);
+      printf("F(b) = %.15e\n", Sum2_value(carry));
+      if (fn->primitive != NULL) {
+         exact = Integrand_exact(fn, a, b);
+         printf("Exact = %.15e, error = %.3e\n", exact,
+               Sum2_value(carry) - exact);
+      }
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Points per second = %.3e (%.3f GB written)\n",
+            (n + 1)/(finish - start), (n + 1)*2*sizeof(double)/1.0e9);
+#     ifdef _OPENMP
+      printf("Processes x threads = %d x %d\n", comm_sz,
+            omp_get_max_threads());
+#     endif
+   }
+
+   MPI_Op_free(&sum2_op);
+   MPI_Type_free(&sum2_mpi_t);
+   free(out[1]);
+   free(out[0]);
+   free(y);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read a, b and n on process 0 and broadcast them
+ */
+void Get_input(
+      int       my_rank  /* in  */,
+      double*   a_p      /* out */,
+      double*   b_p      /* out */,
+      long int* n_p      /* out */) {
+
+   if (my_rank == 0) {
+      printf("Enter a, b, and n\n");
+      if (scanf("%lf %lf %ld", a_p, b_p, n_p) != 3 || *n_p < 1) {
+         fprintf(stderr, "Expected a b n, with n >= 1;  using n = 1\n");
+         *n_p = 1;
+      }
+   }
+   MPI_Bcast(a_p, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(b_p, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(n_p, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+}  /* Get_input */
+
+/*------------------------------------------------------------------
+ * Function:     Piece_totals
+ * Purpose:      First pass of the scan:  evaluate f at the points of
+ *               the piece and add up the areas of each thread's
+ *               panels
+ * Input args:   fn, a, h
+ *               piece:  the panels piece.first..piece.first+count-1
+ * Output args:  y:  f at the count + 1 points of the piece
+ *               thread_total:  sum of each thread's panels
+ *               threads_p:  number of threads
+ * Note:         The threads split the piece with Partition, the same
+ *               way in both passes.
+ */
+void Piece_totals(
+      const integrand_t* fn  /* in  */,
+      double       a         /* in  */,
+      double       h         /* in  */,
+      part_t       piece     /* in  */,
+      double       y[]       /* out */,
+      sum2_t       thread_total[] /* out */,
+      int*         threads_p /* out */) {
+   *threads_p = 1;
+
+#  ifdef _OPENMP
+#  pragma omp parallel default(none) \
+      shared(fn, a, h, piece, y, thread_total, threads_p)
+#  endif
+   {
+#     ifdef _OPENMP
+      int my_rank = omp_get_thread_num(), threads = omp_get_num_threads();
+#     else
+      int my_rank = 0, threads = 1;
+#     endif
+      part_t mine = Partition(piece.count, my_rank, threads, PART_ALIGN);
+      long int j, last = mine.first + mine.count;
+      sum2_t total = SUM2_ZERO;
+
+      if (my_rank == threads-1) last++;   /* The point at the right end */
+      for (j = mine.first; j < last; j++)
+         y[j] = fn->f(a + (piece.first + j)*h);
+#     ifdef _OPENMP
+#     pragma omp barrier
+#     endif
+      for (j = mine.first; j < mine.first + mine.count; j++)
+         Sum2_add(&total, h*(y[j] + y[j+1])/2.0);
+      thread_total[my_rank] = total;
+      if (my_rank == 0) *threads_p = threads;
+   }
+}  /* Piece_totals */
+
+/*------------------------------------------------------------------
+ * Function:     Piece_scan
+ * Purpose:      Second pass of the scan:  F at the right end of every
+ *               panel of the piece
+ * Input args:   a, h, piece, y
+ *               thread_total:  from Piece_totals
+ *               base:  the integral from a to the start of the piece
+ * Output arg:   out:  the pairs x_i F_i, i = piece.first+1, ...,
+ *                  piece.first+count
+ */
+void Piece_scan(
+      double       a         /* in  */,
+      double       h         /* in  */,
+      part_t       piece     /* in  */,
+      const double y[]       /* in  */,
+      const sum2_t thread_total[] /* in  */,
+      sum2_t       base      /* in  */,
+      double       out[]     /* out */) {
+
+#  ifdef _OPENMP
+#  pragma omp parallel default(none) \
+      shared(a, h, piece, y, thread_total, base, out)
+#  endif
+   {
+#     ifdef _OPENMP
+      int my_rank = omp_get_thread_num(), threads = omp_get_num_threads();
+#     else
+      int my_rank = 0, threads = 1;
+#     endif
+      part_t mine = Partition(piece.count, my_rank, threads, PART_ALIGN);
+      sum2_t running = base;
+      long int j;
+      int t;
+
+      for (t = 0; t < my_rank; t++)
+         Sum2_merge(&running, &thread_total[t]);
+      for (j = mine.first; j < mine.first + mine.count; j++) {
+         Sum2_add(&running, h*(y[j] + y[j+1])/2.0);
+         out[2*j] = a + (piece.first + j + 1)*h;
+         out[2*j+1] = Sum2_value(running);
+      }
+   }
+}  /* Piece_scan */
@@ -0,0 +1,300 @@
+/* File:     mpi_trap_dynamic.c
+ * Purpose:  Use MPI to implement the trapezoidal rule with dynamic
+ *           scheduling:  instead of n/comm_sz trapezoids fixed in
+ *           advance, the processes take chunks of samples as they
+ *           finish the previous ones, so a slow process (a busy core,
+ *           an expensive part of [a, b]) takes fewer chunks.
+ *
+ * Input:    a, b, n, optionally followed by the formula of f(x)
+ * Output:   Estimate of the integral from a to b of f(x) using the
+ *           trapezoidal rule and n trapezoids, the elapsed time, and
+ *           for each process the number of chunks and samples it
+ *           took and its busy and idle time.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap_dynamic mpi_trap_dynamic.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_trap_dynamic
+ *              [integrand [schedule]]
+ *           schedule:  master (default) or rma
+ *
+ * Algorithm:
+ *    master:  process 0 hands out the chunks.  The other processes
+ *             send it a request, get back (first, count), sum the
+ *             samples and ask again, until they get count = 0.
+ *    rma:     the index of the next sample is a counter in an MPI
+ *             window on process 0.  Every process (0 included) claims
+ *             a chunk by adding its size to the counter with
+ *             MPI_Fetch_and_op, which returns the chunk's first
+ *             sample;  a chunk that starts past n means the work is
+ *             done.
+ *    In both, the partial sums are added with one MPI_Reduce.
+ *
+ * Notes:
+ *    1.  Chunk sizes are guided:  remaining/(GUIDED_SPLIT*comm_sz)
+ *        samples, at least MIN_CHUNK, rounded up to a multiple of
+ *        PART_ALIGN.  Large chunks at first keep the number of
+ *        requests low;  small ones at the end even out the finish.
+ *    2.  Idle time is the time spent waiting for a chunk plus the
+ *        time waiting for the slowest process at the end.  In the
+ *        master schedule process 0 only hands out chunks (unless it
+ *        is alone).
+ *    3.  f(x) is chosen as in mpi_trap4_time.c.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+#include "../../comum/integrands.h"
+#include "../../comum/expr.h"
+#include "../../comum/partition.h"
+
+#define GUIDED_SPLIT 2
+#define MIN_CHUNK    (1L << 14)
+#define TAG_REQUEST  1
+#define TAG_CHUNK    2
+
+enum {SCHED_MASTER, SCHED_RMA};
+
+typedef struct {
+   double busy;       /* Time summing samples            */
+   double idle;       /* Time waiting                    */
+   long   chunks;
+   long   samples;
+} sched_stats_t;
+
+void Get_input(int my_rank, double* a_p, double* b_p, long* n_p,
+      expr_prog_t* prog_p);
+long Guided_chunk(long remaining, int comm_sz);
+double Master_schedule(double a, double h, long n, const integrand_t* fn,
+      int my_rank, int comm_sz, sched_stats_t* stats);
+double Rma_schedule(double a, double h, long n, const integrand_t* fn,
+      int my_rank, int comm_sz, sched_stats_t* stats);
+void Print_stats(const sched_stats_t* stats, int my_rank, int comm_sz);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, schedule;
+   double a, b, h, local_sum, total_sum = 0.0;
+   double start, finish, wait_start;
+   long n;
+   const integrand_t* fn;
+   expr_prog_t prog;
+   sched_stats_t stats = {0.0, 0.0, 0, 0};
+
+   MPI_Init(NULL, NULL);
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   fn = Integrand_find(argc > 1 ? argv[1] : NULL);
+   schedule = (argc > 2 && strcmp(argv[2], "rma") == 0)
+      ? SCHED_RMA : SCHED_MASTER;
+   if (fn == NULL || (argc > 2 && schedule == SCHED_MASTER
+            && strcmp(argv[2], "master") != 0)) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage: mpiexec -n <p> %s [integrand [master|rma]]\n",
+               argv[0]);
+         Integrand_list(stderr);
+      }
+      MPI_Finalize();
+      return 0;
+   }
+
+   Get_input(my_rank, &a, &b, &n, &prog);
+   if (prog.n_instr == EXPR_BAD_PROGRAM) {
+      MPI_Finalize();
+      return 0;
+   }
+   if (prog.n_instr != EXPR_NO_PROGRAM) fn = Expr_integrand(&prog);
+   h = (b-a)/n;
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   if (schedule == SCHED_RMA)
+      local_sum = Rma_schedule(a, h, n, fn, my_rank, comm_sz, &stats);
+   else
+      local_sum = Master_schedule(a, h, n, fn, my_rank, comm_sz, &stats);
+
+   /* Waiting for the slowest process is idle time too */
+   wait_start = MPI_Wtime();
+   MPI_Reduce(&local_sum, &total_sum, 1, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   MPI_Barrier(MPI_COMM_WORLD);
+   finish = MPI_Wtime();
+   stats.idle += finish - wait_start;
+
+   if (my_rank == 0) {
+      total_sum += (fn->f(a) + fn->f(b))/2.0;
+      printf("f(x) = %s\n", fn->formula);
+      printf("With n = %ld trapezoids, our estimate\n", n);
+      printf("of the integral from %f to %f = %.15e\n", a, b,
+            h*total_sum);
+      printf("Elapsed time = %.4f\n", finish - start);
+      printf("Schedule: %s\n", schedule == SCHED_RMA ? "rma" : "master");
+   }
+   Print_stats(&stats, my_rank, comm_sz);
+
+   MPI_Finalize();
+   return 0;
+} /*  main  */
+
+/*------------------------------------------------------------------
+ * Function:     Get_input
+ * Purpose:      Read a, b, n and the formula of f(x) on process 0
+ *               and broadcast them
+ */
+void Get_input(
+      int          my_rank  /* in  */,
+      double*      a_p      /* out */,
+      double*      b_p      /* out */,
+      long*        n_p      /* out */,
+      expr_prog_t* prog_p   /* out */) {
+   double dbuf[2];
+   char err[EXPR_MAX_TEXT];
+
+   if (my_rank == 0) {
+      printf("Enter a, b, and n [and f(x)]\n");
+      scanf("%lf %lf %ld", &dbuf[0], &dbuf[1], n_p);
+      if (!Expr_read(stdin, prog_p, err))
+         fprintf(stderr, "f(x): %s\n", err);
+   }
+   MPI_Bcast(dbuf, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(n_p, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+   Expr_bcast(prog_p, 0, MPI_COMM_WORLD);
+   *a_p = dbuf[0];
+   *b_p = dbuf[1];
+}  /* Get_input */
+
+/*------------------------------------------------------------------
+ * Function:     Guided_chunk
+ * Purpose:      Size of the next chunk
+ * Input args:   remaining:  samples not handed out yet
+ *               comm_sz
+ */
+long Guided_chunk(long remaining, int comm_sz) {
+   long chunk = remaining/(GUIDED_SPLIT*comm_sz);
+
+   if (chunk < MIN_CHUNK) chunk = MIN_CHUNK;
+   chunk = (chunk + PART_ALIGN - 1)/PART_ALIGN*PART_ALIGN;
+   return chunk < remaining ? chunk : remaining;
+}  /* Guided_chunk */
+
+/*------------------------------------------------------------------
+ * Function:     Master_schedule
+ * Purpose:      Sum the interior samples 1..n-1, with the chunks
+ *               handed out by process 0
+ * Return val:   this process' sum of f(a + i*h)
+ */
+double Master_schedule(double a, double h, long n, const integrand_t* fn,
+      int my_rank, int comm_sz, sched_stats_t* stats) {
+   long next = 1, chunk[2], request = 0;
+   int done = 0;
+   double sum = 0.0, t;
+   MPI_Status status;
+
+   if (comm_sz == 1) {
+      t = MPI_Wtime();
+      sum = fn->trap_sum(a, h, 1, n-1);
+      stats->busy = MPI_Wtime() - t;
+      stats->chunks = 1;
+      stats->samples = n-1;
+      return sum;
+   }
+
+   if (my_rank == 0) {
+      /* Coordinator:  answer requests until every worker is done */
+      while (done < comm_sz-1) {
+         MPI_Recv(&request, 1, MPI_LONG, MPI_ANY_SOURCE, TAG_REQUEST,
+               MPI_COMM_WORLD, &status);
+         chunk[0] = next;
+         chunk[1] = Guided_chunk(n - next, comm_sz - 1);
+         next += chunk[1];
+         if (chunk[1] == 0) done++;
+         MPI_Send(chunk, 2, MPI_LONG, status.MPI_SOURCE, TAG_CHUNK,
+               MPI_COMM_WORLD);
+      }
+      return 0.0;
+   }
+
+   for (;;) {
+      t = MPI_Wtime();
+      MPI_Send(&request, 1, MPI_LONG, 0, TAG_REQUEST, MPI_COMM_WORLD);
+      MPI_Recv(chunk, 2, MPI_LONG, 0, TAG_CHUNK, MPI_COMM_WORLD,
+            MPI_STATUS_IGNORE);
+      stats->idle += MPI_Wtime() - t;
+      if (chunk[1] == 0) break;
+
+      t = MPI_Wtime();
+      sum += fn->trap_sum(a, h, chunk[0], chunk[1]);
+      stats->busy += MPI_Wtime() - t;
+      stats->chunks++;
+      stats->samples += chunk[1];
+   }
+   return sum;
+}  /* Master_schedule */
+
+/*------------------------------------------------------------------
+ * Function:     Rma_schedule
+ * Purpose:      Sum the interior samples 1..n-1, claiming chunks from
+ *               a shared counter in a window on process 0
+ * Return val:   this process' sum of f(a + i*h)
+ */
+double Rma_schedule(double a, double h, long n, const integrand_t* fn,
+      int my_rank, int comm_sz, sched_stats_t* stats) {
+   long *counter, first, count, remaining = n-1;
+   double sum = 0.0, t;
+   MPI_Win win;
+
+   MPI_Win_allocate(my_rank == 0 ? sizeof(long) : 0, sizeof(long),
+         MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win);
+   if (my_rank == 0) {
+      /* Local stores to a window need an access epoch too */
+      MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+      *counter = 1;
+      MPI_Win_unlock(0, win);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   MPI_Win_lock_all(0, win);
+
+   for (;;) {
+      /* The size comes from the last value of the counter we saw */
+      count = Guided_chunk(remaining, comm_sz);
+      t = MPI_Wtime();
+      MPI_Fetch_and_op(&count, &first, MPI_LONG, 0, 0, MPI_SUM, win);
+      MPI_Win_flush(0, win);
+      stats->idle += MPI_Wtime() - t;
+      if (first >= n) break;
+      if (first + count > n) count = n - first;
+
+      t = MPI_Wtime();
+      sum += fn->trap_sum(a, h, first, count);
+      stats->busy += MPI_Wtime() - t;
+      stats->chunks++;
+      stats->samples += count;
+      remaining = n - (first + count);
+   }
+
+   MPI_Win_unlock_all(win);
+   MPI_Win_free(&win);
+   return sum;
+}  /* Rma_schedule */
+
+/*------------------------------------------------------------------
+ * Function:     Print_stats
+ * Purpose:      Gather the statistics of every process on process 0
+ *               and print them
+ */
+void Print_stats(const sched_stats_t* stats, int my_rank, int comm_sz) {
+   double mine[4], all[4*comm_sz];
+   int q;
+
+   mine[0] = stats->chunks;
+   mine[1] = stats->samples;
+   mine[2] = stats->busy;
+   mine[3] = stats->idle;
+   MPI_Gather(mine, 4, MPI_DOUBLE, all, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      printf("%6s %8s %14s %10s %10s\n", "rank", "chunks", "samples",
+            "busy", "idle");
+      for (q = 0; q < comm_sz; q++)
+         printf("%6d %8.0f %14.0f %10.4f %10.4f\n", q, all[4*q],
+               all[4*q+1], all[4*q+2], all[4*q+3]);
+   }
+}  /* Print_stats */
@@ -0,0 +1,156 @@
+/* File:     mpi_trap_table.c
+ * Purpose:  Use MPI (and OpenMP) to integrate tabulated samples
+ *           (x_i, y_i), unevenly spaced if need be, with the
+ *           trapezoidal rule, reading them straight from a binary
+ *           file with mmap.
+ *
+ * Input:    none:  the samples are in the file named on the command
+ *           line, as pairs of doubles x_0 y_0 x_1 y_1 ... (in the
+ *           machine's byte order, no header)
+ * Output:   Estimate of the integral, the number of samples, the
+ *           elapsed time and the rate in samples and bytes per second
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap_table mpi_trap_table.c
+ *           hybrid MPI+OpenMP version:
+ *           mpicc -g -Wall -O2 -fopenmp -o mpi_trap_table_omp \
+ *              mpi_trap_table.c
+ * Run:      mpiexec -n <number of processes> ./mpi_trap_table <file>
+ *
+ * Algorithm:
+ *    1.  Every process opens the file and finds the number of samples
+ *        from its size.
+ *    2.  The samples - 1 intervals are split among the processes
+ *        (comum/partition.h), and in the hybrid version each
+ *        process' intervals among its threads.
+ *    3.  Each thread maps its samples, plus the one at its right
+ *        boundary, and sums its intervals a window at a time
+ *        (comum/tabulated.h).
+ *    4.  A compensated MPI_Reduce (comum/summation.h) adds the
+ *        processes' results on process 0.
+ *
+ * Notes:
+ *    1.  The processes must see the same file:  on a cluster the path
+ *        must be on a shared file system.
+ *    2.  The file is never read into memory as a whole:  each thread
+ *        keeps about one window (TAB_WINDOW bytes) of it mapped in.
+ *    3.  In the hybrid version MPI is initialized with
+ *        MPI_THREAD_FUNNELED:  only the master thread calls MPI.
+ *    4.  To make a test file of samples of f on an uneven grid, e.g.
+ *        with Python and numpy:
+ *           x = np.sort(np.random.uniform(a, b, n))
+ *           np.column_stack((x, f(x))).tofile("samples.bin")
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "../../comum/tabulated.h"
+#include "../../comum/summation.h"
+#include "../../comum/partition.h"
+
+double Local_table(int fd, part_t part, tab_stats_t* stats);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, fd, ok, all_ok;
+   long int samples = 0, decreasing;
+   double local_int, total_int, start, finish, elapsed;
+   part_t part;
+   tab_stats_t stats = {0, 0};
+
+#  ifdef _OPENMP
+   int provided;
+
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+#  else
+   MPI_Init(NULL, NULL);
+#  endif
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
+
+   if (argc != 2) {
+      if (my_rank == 0)
+         fprintf(stderr, "usage: mpiexec -n <p> %s <file>\n", argv[0]);
+      MPI_Finalize();
+      return 0;
+   }
+
+   fd = Tab_open(argv[1], &samples);
+   ok = fd >= 0 && samples >= 2;
+   MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+   if (!all_ok) {
+      if (!ok)
+         fprintf(stderr, "Process %d: %s isn't a file of 2 or more "
+               "(x, y) pairs of doubles\n", my_rank, argv[1]);
+      if (fd >= 0) close(fd);
+      MPI_Finalize();
+      return 0;
+   }
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   start = MPI_Wtime();
+   part = Partition(samples - 1, my_rank, comm_sz, TAB_ALIGN);
+   local_int = Local_table(fd, part, &stats);
+   total_int = Sum2_reduce(local_int, 0, MPI_COMM_WORLD);
+   finish = MPI_Wtime();
+   elapsed = finish - start;
+   close(fd);
+
+   MPI_Reduce(&stats.decreasing, &decreasing, 1, MPI_LONG, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   if (my_rank == 0) {
+      printf("With %ld samples of %s, our estimate\n", samples, argv[1]);
+      printf("of the integral = %.15e\n", total_int);
+      printf("Elapsed time = %.4f\n", elapsed);
+      printf("Samples per second = %.3e (%.3f GB/s)\n", samples/elapsed,
+            samples*TAB_SAMPLE_BYTES/elapsed/1.0e9);
+      if (decreasing > 0)
+         printf("Warning: x decreases in %ld intervals\n", decreasing);
+#     ifdef _OPENMP
+      printf("Processes x threads = %d x %d\n", comm_sz,
+            omp_get_max_threads());
+#     endif
+   }
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:     Local_table
+ * Purpose:      Trapezoidal rule over this process' intervals of the
+ *               file;  in the hybrid version the intervals are split
+ *               among the threads, each mapping its own samples
+ * Input args:   fd, part
+ * In/out arg:   stats
+ * Return val:   this process' estimate (NAN if a mapping failed)
+ */
+double Local_table(
+      int          fd     /* in     */,
+      part_t       part   /* in     */,
+      tab_stats_t* stats  /* in/out */) {
+#  ifdef _OPENMP
+   sum2_t total = SUM2_ZERO;
+   long int intervals = 0, decreasing = 0;
+
+#  pragma omp parallel default(none) shared(fd, part) \
+      reduction(sum2: total) reduction(+: intervals, decreasing)
+   {
+      part_t mine = Partition(part.count, omp_get_thread_num(),
+            omp_get_num_threads(), TAB_ALIGN);
+      tab_stats_t my_stats = {0, 0};
+
+      Sum2_add(&total, Tab_trap(fd, part.first + mine.first, mine.count,
+               &my_stats));
+      intervals += my_stats.intervals;
+      decreasing += my_stats.decreasing;
+   }
+   stats->intervals += intervals;
+   stats->decreasing += decreasing;
+   return Sum2_value(total);
+#  else
+   return Tab_trap(fd, part.first, part.count, stats);
+#  endif
+}  /* Local_table */
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Compara layouts processos x threads com o mesmo total de nucleos:
+# 1 x N, N x 1 e as combinacoes intermediarias (versao hibrida,
+# mpi_trap4_time_omp).  OMP_NUM_THREADS vai pelo ambiente do mpiexec,
+# o que basta numa maquina so;  --bind-to none e a grafia do Open MPI
+# (no MPICH:  -bind-to none).
+
+N=${1:-$(nproc)}
+
+for p in $(seq 1 $N)
+do
+    if [ $((N % p)) -ne 0 ]; then continue; fi
+    t=$((N / p))
+    echo -e "\nRodando com $p processos x $t threads"
+    for i in {1..3}
+    do
+        OMP_NUM_THREADS=$t mpiexec -n $p --bind-to none \
+            ./mpi_trap4_time_omp < entrada.txt
+    done
+done
@@ -0,0 +1,159 @@
+/* File:     checkpoint.h
+ *
+ * Purpose:  Checkpoint file of the partial sums of a long integration,
+ *           so a job that is stopped can be restarted without
+ *           redoing the finished work, with the same or a different
+ *           number of processes.
+ *
+ *           The n panels are cut into Ckpt_blocks(n) blocks, which
+ *           depend only on n (not on the number of processes).  The
+ *           file holds a header with the key of the integration
+ *           (formula of f, rule, summation mode, a, b, n) and one
+ *           record per block:
+ *
+ *              done   1 if the block is finished
+ *              sum    the block's estimate
+ *
+ *           A process writes the record of each block it finishes at
+ *           its own offset in the file (pwrite), so processes never
+ *           write the same bytes.
+ *
+ * Usage:    On one process:
+ *              fd = Ckpt_open(path, &key, records, &resumed);
+ *           then on every process:
+ *              fd = open(path, O_WRONLY);  (or the fd above)
+ *              for each unfinished block k of mine:
+ *                 records[k].sum = ...;  records[k].done = 1;
+ *                 Ckpt_write(fd, k, &records[k]);
+ *           and when the job is over, remove(path).
+ *
+ * Notes:
+ *   1.  The file is only read back on machines with the same layout
+ *       of ckpt_header_t.  A file whose key doesn't match is replaced
+ *       by a new one.
+ *   2.  Each record is written with a single pwrite, and the file is
+ *       flushed to disk (fdatasync) at most every CKPT_SYNC_SECONDS,
+ *       so a job killed between flushes loses at most that much.
+ *   3.  The processes must see the same file:  on a cluster the path
+ *       must be on a shared file system.
+ */
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "partition.h"
+
+#define CKPT_MAGIC         0x54524150434b5054ULL   /* "TRAPCKPT" */
+#define CKPT_FORMULA       256
+#define CKPT_NAME          32
+#define CKPT_PATH          1024
+#define CKPT_MAX_BLOCKS    4096
+#define CKPT_MIN_BLOCK     (1L << 20)   /* Panels */
+#define CKPT_SYNC_SECONDS  5.0
+
+typedef struct {
+   unsigned long long magic;
+   char   formula[CKPT_FORMULA];
+   char   rule[CKPT_NAME];
+   int    mode;
+   double a, b;
+   long   n;
+   long   blocks;
+} ckpt_header_t;
+
+typedef struct {
+   double sum;
+   long   done;
+} ckpt_record_t;
+
+/*-------------------------------------------------------------------
+ * Function:    Ckpt_blocks
+ * Purpose:     Number of blocks the n panels are cut into:  blocks of
+ *              at least CKPT_MIN_BLOCK panels, at most CKPT_MAX_BLOCKS
+ *              of them
+ */
+static inline long Ckpt_blocks(long n) {
+   long blocks = n/CKPT_MIN_BLOCK;
+
+   if (blocks < 1) blocks = 1;
+   if (blocks > CKPT_MAX_BLOCKS) blocks = CKPT_MAX_BLOCKS;
+   return blocks;
+}  /* Ckpt_blocks */
+
+/*-------------------------------------------------------------------
+ * Function:    Ckpt_block
+ * Purpose:     Panels of block k
+ */
+static inline part_t Ckpt_block(const ckpt_header_t* key, long k) {
+   return Partition(key->n, (int) k, (int) key->blocks, PART_ALIGN);
+}  /* Ckpt_block */
+
+/*-------------------------------------------------------------------
+ * Function:    Ckpt_key
+ * Purpose:     Fill in the header of the checkpoint of an integration
+ */
+static inline void Ckpt_key(ckpt_header_t* key, const char* formula,
+      const char* rule, int mode, double a, double b, long n) {
+   memset(key, 0, sizeof(ckpt_header_t));
+   key->magic = CKPT_MAGIC;
+   strncpy(key->formula, formula, CKPT_FORMULA - 1);
+   strncpy(key->rule, rule, CKPT_NAME - 1);
+   key->mode = mode;
+   key->a = a;
+   key->b = b;
+   key->n = n;
+   key->blocks = Ckpt_blocks(n);
+}  /* Ckpt_key */
+
+/*-------------------------------------------------------------------
+ * Function:    Ckpt_open
+ * Purpose:     Open the checkpoint at path and read its records, or
+ *              start a new one if there is none for this key
+ * In args:     path, key
+ * Out args:    records:  key->blocks records
+ *              resumed:  1 if the records were read from the file
+ * Return val:  file descriptor open for writing, or -1 on error
+ */
+static inline int Ckpt_open(const char* path, const ckpt_header_t* key,
+      ckpt_record_t records[], int* resumed) {
+   ckpt_header_t stored;
+   size_t size = key->blocks*sizeof(ckpt_record_t);
+   int fd;
+
+   *resumed = 0;
+   fd = open(path, O_RDWR | O_CREAT, 0644);
+   if (fd < 0) return -1;
+
+   if (pread(fd, &stored, sizeof(stored), 0) == sizeof(stored)
+         && memcmp(&stored, key, sizeof(stored)) == 0
+         && pread(fd, records, size, sizeof(stored)) == (ssize_t) size) {
+      *resumed = 1;
+      return fd;
+   }
+
+   memset(records, 0, size);
+   if (ftruncate(fd, 0) < 0
+         || pwrite(fd, key, sizeof(*key), 0) != sizeof(*key)
+         || pwrite(fd, records, size, sizeof(*key)) != (ssize_t) size
+         || fdatasync(fd) < 0) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}  /* Ckpt_open */
+
+/*-------------------------------------------------------------------
+ * Function:    Ckpt_write
+ * Purpose:     Write the record of block k
+ * Return val:  1 on success, 0 otherwise
+ */
+static inline int Ckpt_write(int fd, long k, const ckpt_record_t* record) {
+   off_t offset = sizeof(ckpt_header_t) + k*sizeof(ckpt_record_t);
+
+   return pwrite(fd, record, sizeof(*record), offset) == sizeof(*record);
+}  /* Ckpt_write */
+
+#endif /* _CHECKPOINT_H_ */
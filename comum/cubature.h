@@ -0,0 +1,242 @@
+/* File:     cubature.h
+ *
+ * Purpose:  Tensor-product cubature (trapezoidal or Simpson rule in
+ *           every direction) of functions of 2 or 3 variables over a
+ *           box, in the style of integrands.h:  the integrand is
+ *           chosen at run time by name, and each one has its own
+ *           kernel with the formula inlined.
+ *
+ *              const cube_integrand_t* fn = Cube_find("gauss");
+ *              count[d] = Cube_points(rule, n[d]);   (or a part of them)
+ *              Cube_nodes(rule, lo[d], h[d], n[d], first, count[d],
+ *                    node[d], weight[d]);
+ *              sum = Cube_box_sum(fn, node, weight, count);
+ *
+ *           The cubature is the sum over the grid of
+ *           w_x[i]*w_y[j]*w_z[k]*f(x_i, y_j, z_k).  A box of the grid
+ *           is summed in tiles of CUBE_TILE x values:  for each tile,
+ *           every (y, z) row of the box is summed by the integrand's
+ *           row kernel, so the nodes and weights of the tile stay in
+ *           the L1 cache while the rows go by.
+ *
+ * Adding an integrand:
+ *    1.  #define F3_<name>(x, y, z) with its formula
+ *    2.  CUBE_DEFINE(<name>), and an exact integral over a box if
+ *        one is known
+ *    3.  Add a line to cube_table
+ *
+ * Notes:
+ *   1.  In 2D the integrands are evaluated with z = 0, so the
+ *       formulas are chosen to make sense with z = 0.
+ *   2.  The row kernels keep CUBE_LANES independent sums, so the
+ *       compiler can vectorize them without reordering additions;
+ *       they are compiled for AVX-512, AVX2 and plain x86-64, and
+ *       the version is picked when the program starts.
+ *   3.  The rows are added with a compensated sum (comum/summation.h):
+ *       with 10^12 points there are up to 10^9 of them.
+ *   4.  Simpson's rule uses the panel midpoints, so n panels in a
+ *       direction have 2n+1 nodes (with weights H/6*(1 4 2 4 ... 4 1)).
+ */
+#ifndef _CUBATURE_H_
+#define _CUBATURE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "summation.h"
+
+#define CUBE_MAX_DIM 3
+#define CUBE_LANES   8
+#define CUBE_TILE    1024   /* x values per tile:  16 KB of nodes and weights */
+
+enum {CUBE_TRAP, CUBE_SIMPSON, CUBE_RULE_COUNT};
+static const char* cube_rule_names[CUBE_RULE_COUNT] = {"trap", "simpson"};
+
+typedef double (*cube_row_t)(const double x[], const double w[], long count,
+      double y, double z);
+
+typedef struct {
+   const char* name;
+   const char* formula;
+   cube_row_t  row_sum;    /* sum of w[i]*f(x[i], y, z), i < count   */
+   double (*exact)(const double lo[], const double hi[], int dim);
+                           /* NULL if not known                      */
+} cube_integrand_t;
+
+#define CUBE_DEFINE(name)                                               \
+__attribute__ ((target_clones ("avx512f", "avx2", "default")))          \
+static double Cube_row_##name(const double x[], const double w[],       \
+      long count, double y, double z) {                                 \
+   double acc[CUBE_LANES] = {0.0}, sum = 0.0;                           \
+   long i;                                                              \
+   int k;                                                               \
+                                                                        \
+   for (i = 0; i + CUBE_LANES <= count; i += CUBE_LANES)                \
+      for (k = 0; k < CUBE_LANES; k++)                                  \
+         acc[k] += w[i+k]*F3_##name(x[i+k], y, z);                      \
+   for (; i < count; i++)                                               \
+      sum += w[i]*F3_##name(x[i], y, z);                                \
+   for (k = 0; k < CUBE_LANES; k++)                                     \
+      sum += acc[k];                                                    \
+   return sum;                                                          \
+}
+
+/*--------------------------------------------------------------------
+ * Integrands
+ */
+#define F3_poly(x, y, z)  ((x)*(x) + (y)*(y) + (z)*(z))
+CUBE_DEFINE(poly)
+
+static double Cube_exact_poly(const double lo[], const double hi[],
+      int dim) {
+   double total = 0.0, term;
+   int d, e;
+
+   for (d = 0; d < dim; d++) {
+      term = (hi[d]*hi[d]*hi[d] - lo[d]*lo[d]*lo[d])/3.0;
+      for (e = 0; e < dim; e++)
+         if (e != d) term *= hi[e] - lo[e];
+      total += term;
+   }
+   return total;
+}  /* Cube_exact_poly */
+
+#define F3_gauss(x, y, z)  exp(-((x)*(x) + (y)*(y) + (z)*(z)))
+CUBE_DEFINE(gauss)
+
+static double Cube_exact_gauss(const double lo[], const double hi[],
+      int dim) {
+   double prod = 1.0;
+   int d;
+
+   for (d = 0; d < dim; d++)
+      prod *= sqrt(M_PI)/2.0*(erf(hi[d]) - erf(lo[d]));
+   return prod;
+}  /* Cube_exact_gauss */
+
+#define F3_cosprod(x, y, z)  (cos(x)*cos(y)*cos(z))
+CUBE_DEFINE(cosprod)
+
+static double Cube_exact_cosprod(const double lo[], const double hi[],
+      int dim) {
+   double prod = 1.0;
+   int d;
+
+   for (d = 0; d < dim; d++)
+      prod *= sin(hi[d]) - sin(lo[d]);
+   return prod;
+}  /* Cube_exact_cosprod */
+
+#define F3_runge(x, y, z)  (1.0/(1.0 + 25.0*((x)*(x) + (y)*(y) + (z)*(z))))
+CUBE_DEFINE(runge)
+
+static const cube_integrand_t cube_table[] = {
+   {"poly",    "x^2 + y^2 + z^2",        Cube_row_poly,    Cube_exact_poly},
+   {"gauss",   "exp(-(x^2 + y^2 + z^2))", Cube_row_gauss,  Cube_exact_gauss},
+   {"cosprod", "cos(x)*cos(y)*cos(z)",   Cube_row_cosprod, Cube_exact_cosprod},
+   {"runge",   "1/(1 + 25(x^2 + y^2 + z^2))", Cube_row_runge, NULL},
+};
+
+#define CUBE_COUNT ((int) (sizeof(cube_table)/sizeof(cube_table[0])))
+#define CUBE_DEFAULT "gauss"
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_find
+ * Purpose:     Look up an integrand by name
+ * In arg:      name:  e.g. "gauss" (NULL gives CUBE_DEFAULT)
+ * Return val:  pointer into cube_table, or NULL if there is no
+ *              integrand with that name
+ */
+static inline const cube_integrand_t* Cube_find(const char* name) {
+   int i;
+
+   if (name == NULL) name = CUBE_DEFAULT;
+   for (i = 0; i < CUBE_COUNT; i++)
+      if (strcmp(cube_table[i].name, name) == 0)
+         return &cube_table[i];
+   return NULL;
+}  /* Cube_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_list
+ * Purpose:     Print the integrands and rules (for the Usage functions)
+ */
+static inline void Cube_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   integrands:\n");
+   for (i = 0; i < CUBE_COUNT; i++)
+      fprintf(fp, "      %-8s %s\n", cube_table[i].name,
+            cube_table[i].formula);
+   fprintf(fp, "   rules: trap simpson\n");
+}  /* Cube_list */
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_rule_find
+ * Return val:  CUBE_TRAP (also for NULL), CUBE_SIMPSON, or -1
+ */
+static inline int Cube_rule_find(const char* name) {
+   int r;
+
+   if (name == NULL) return CUBE_TRAP;
+   for (r = 0; r < CUBE_RULE_COUNT; r++)
+      if (strcmp(cube_rule_names[r], name) == 0) return r;
+   return -1;
+}  /* Cube_rule_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_points
+ * Purpose:     Number of nodes of n panels of the rule in one direction
+ */
+static inline long Cube_points(int rule, long n) {
+   return rule == CUBE_SIMPSON ? 2*n + 1 : n + 1;
+}  /* Cube_points */
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_nodes
+ * Purpose:     Nodes and weights first..first+count-1 of the rule with
+ *              panels of width h starting at lo, in one direction
+ * Out args:    node, weight:  count values each
+ */
+static inline void Cube_nodes(int rule, double lo, double h, long n,
+      long first, long count, double node[], double weight[]) {
+   long points = Cube_points(rule, n), i, g;
+
+   for (i = 0; i < count; i++) {
+      g = first + i;
+      if (rule == CUBE_SIMPSON) {
+         node[i] = lo + g*(h/2.0);
+         weight[i] = (g == 0 || g == points-1) ? h/6.0
+            : (g % 2 == 1) ? 4.0*h/6.0 : 2.0*h/6.0;
+      } else {
+         node[i] = lo + g*h;
+         weight[i] = (g == 0 || g == points-1) ? h/2.0 : h;
+      }
+   }
+}  /* Cube_nodes */
+
+/*-------------------------------------------------------------------
+ * Function:    Cube_box_sum
+ * Purpose:     Weighted sum of fn over the grid node[0] x node[1] x
+ *              node[2] (count[d] nodes in direction d;  in 2D use one
+ *              z node 0.0 with weight 1.0)
+ * Return val:  the sum
+ */
+static inline double Cube_box_sum(const cube_integrand_t* fn,
+      double* const node[CUBE_MAX_DIM], double* const weight[CUBE_MAX_DIM],
+      const long count[CUBE_MAX_DIM]) {
+   sum2_t total = SUM2_ZERO;
+   long t, len, j, k;
+
+   for (t = 0; t < count[0]; t += CUBE_TILE) {
+      len = (count[0] - t < CUBE_TILE) ? count[0] - t : CUBE_TILE;
+      for (k = 0; k < count[2]; k++)
+         for (j = 0; j < count[1]; j++)
+            Sum2_add(&total, weight[2][k]*weight[1][j]
+                  *fn->row_sum(node[0] + t, weight[0] + t, len,
+                     node[1][j], node[2][k]));
+   }
+   return Sum2_value(total);
+}  /* Cube_box_sum */
+
+#endif /* _CUBATURE_H_ */
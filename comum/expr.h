@@ -0,0 +1,591 @@
+/* File:     expr.h
+ *
+ * Purpose:  Integrands typed as text, e.g. "sin(x)*exp(-x*x)".  The
+ *           text is compiled once (on process 0) to a small register
+ *           bytecode that can be broadcast to the other processes,
+ *           and each process runs it with an interpreter that works
+ *           on blocks of EXPR_BLOCK x values at a time.  Each
+ *           instruction is then a short loop over the block, so the
+ *           cost of decoding it is paid once per EXPR_BLOCK samples
+ *           and the loop itself is vectorized by the compiler.
+ *
+ * Syntax:   numbers, x, pi, + - * / ^ (power), unary minus,
+ *           parentheses and the functions sin cos tan exp log sqrt
+ *           abs atan.
+ *
+ * Usage:
+ *           expr_prog_t prog;
+ *           char err[EXPR_MAX_TEXT];
+ *           if (!Expr_compile("sin(x)*exp(-x*x)", &prog, err)) ...
+ *           sum = Expr_trap_sum(&prog, a, h, 1, n-1);
+ *
+ *           Expr_integrand wraps a program in an integrand_t (see
+ *           integrands.h), so it can be used wherever a library
+ *           integrand can.  If mpi.h is included before this file,
+ *           Expr_bcast is also defined.
+ *
+ * Notes:
+ *   1.  Register 0 holds x, registers 1..n_const hold the constants
+ *       and the rest are temporaries.  Constant subexpressions are
+ *       folded at compile time.
+ *   2.  Link with -lm.
+ */
+#ifndef _EXPR_H_
+#define _EXPR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "integrands.h"
+
+#define EXPR_BLOCK     16   /* x values per instruction dispatch */
+#define EXPR_MAX_INSTR 128
+#define EXPR_MAX_REGS  64
+#define EXPR_MAX_TEXT  256
+
+typedef enum {
+   EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_POW, EXPR_NEG,
+   EXPR_SIN, EXPR_COS, EXPR_TAN, EXPR_EXP, EXPR_LOG, EXPR_SQRT,
+   EXPR_ABS, EXPR_ATAN
+} expr_op_t;
+
+/* dst = a op b  (b is ignored by the unary operations) */
+typedef struct {
+   unsigned char op, dst, a, b;
+} expr_instr_t;
+
+typedef struct {
+   int n_instr;             /* < 0:  no expression / syntax error  */
+   int n_const;
+   int n_regs;
+   int result;              /* register holding f(x)               */
+   expr_instr_t code[EXPR_MAX_INSTR];
+   double consts[EXPR_MAX_REGS];
+   char text[EXPR_MAX_TEXT];  /* Source, for printing and keys      */
+} expr_prog_t;
+
+#define EXPR_NO_PROGRAM  (-1)
+#define EXPR_BAD_PROGRAM (-2)
+
+/*===================================================================
+ * Compiler
+ */
+typedef struct {
+   const char*  s;          /* Next character to read   */
+   expr_prog_t* p;
+   int          top;        /* Next free temporary      */
+   char*        err;
+} expr_parser_t;
+
+static int Expr_parse_sum(expr_parser_t* ps);
+
+#define EXPR_FIRST_TEMP(p) (1 + (p)->n_const)
+
+static inline int Expr_error(expr_parser_t* ps, const char* msg) {
+   if (ps->err[0] == '\0')
+      snprintf(ps->err, EXPR_MAX_TEXT, "%s at \"%.20s\"", msg, ps->s);
+   return -1;
+}  /* Expr_error */
+
+static inline void Expr_skip(expr_parser_t* ps) {
+   while (isspace((unsigned char) *ps->s)) ps->s++;
+}  /* Expr_skip */
+
+static inline int Expr_is_const(const expr_prog_t* p, int r) {
+   return r >= 1 && r < EXPR_FIRST_TEMP(p);
+}  /* Expr_is_const */
+
+static inline int Expr_is_temp(const expr_prog_t* p, int r) {
+   return r >= EXPR_FIRST_TEMP(p);
+}  /* Expr_is_temp */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_const
+ * Purpose:     Register holding the constant val (added to the
+ *              constant table if it's not there yet)
+ * Note:        At most EXPR_MAX_REGS/2 - 1 constants, so that during
+ *              the first pass of Expr_compile the temporaries can
+ *              live in the upper half of the registers.
+ */
+static int Expr_const(expr_parser_t* ps, double val) {
+   expr_prog_t* p = ps->p;
+   int k;
+
+   for (k = 0; k < p->n_const; k++)
+      if (p->consts[k] == val) return 1 + k;
+   if (1 + p->n_const >= EXPR_MAX_REGS/2)
+      return Expr_error(ps, "too many constants");
+   p->consts[p->n_const++] = val;
+   return p->n_const;
+}  /* Expr_const */
+
+static inline double Expr_apply(int op, double a, double b) {
+   switch (op) {
+      case EXPR_ADD:  return a + b;
+      case EXPR_SUB:  return a - b;
+      case EXPR_MUL:  return a * b;
+      case EXPR_DIV:  return a / b;
+      case EXPR_POW:  return pow(a, b);
+      case EXPR_NEG:  return -a;
+      case EXPR_SIN:  return sin(a);
+      case EXPR_COS:  return cos(a);
+      case EXPR_TAN:  return tan(a);
+      case EXPR_EXP:  return exp(a);
+      case EXPR_LOG:  return log(a);
+      case EXPR_SQRT: return sqrt(a);
+      case EXPR_ABS:  return fabs(a);
+      default:        return atan(a);
+   }
+}  /* Expr_apply */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_emit
+ * Purpose:     Emit dst = a op b and return dst.  If a and b are
+ *              both constants the result is folded into a new
+ *              constant instead.
+ * Note:        Temporaries are used as a stack:  the result goes
+ *              into a's temporary if it has one, else b's, else a
+ *              new one.
+ */
+static int Expr_emit(expr_parser_t* ps, int op, int a, int b) {
+   expr_prog_t* p = ps->p;
+   int dst;
+
+   if (a < 0 || b < 0) return -1;
+   if (Expr_is_const(p, a) && (b == a || Expr_is_const(p, b)))
+      return Expr_const(ps, Expr_apply(op, p->consts[a-1],
+               p->consts[b-1]));
+
+   if (Expr_is_temp(p, a))
+      dst = a;
+   else if (Expr_is_temp(p, b))
+      dst = b;
+   else
+      dst = ps->top++;
+   if (Expr_is_temp(p, b) && b != dst) ps->top--;
+
+   if (ps->top > EXPR_MAX_REGS) return Expr_error(ps, "too complex");
+   if (p->n_instr >= EXPR_MAX_INSTR) return Expr_error(ps, "too long");
+   p->code[p->n_instr].op  = op;
+   p->code[p->n_instr].dst = dst;
+   p->code[p->n_instr].a   = a;
+   p->code[p->n_instr].b   = b;
+   p->n_instr++;
+   if (ps->top > p->n_regs) p->n_regs = ps->top;
+
+   return dst;
+}  /* Expr_emit */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_parse_primary
+ * Purpose:     number | x | pi | func(sum) | (sum)
+ * Return val:  register with the value, or -1 on error
+ */
+static int Expr_parse_primary(expr_parser_t* ps) {
+   static const struct {const char* name; int op;} funcs[] = {
+      {"sin", EXPR_SIN}, {"cos", EXPR_COS}, {"tan", EXPR_TAN},
+      {"exp", EXPR_EXP}, {"log", EXPR_LOG}, {"sqrt", EXPR_SQRT},
+      {"abs", EXPR_ABS}, {"atan", EXPR_ATAN}
+   };
+   char name[16];
+   char* end;
+   double val;
+   int len = 0, r, k;
+
+   Expr_skip(ps);
+   if (isdigit((unsigned char) *ps->s) || *ps->s == '.') {
+      val = strtod(ps->s, &end);
+      ps->s = end;
+      return Expr_const(ps, val);
+   }
+   if (*ps->s == '(') {
+      ps->s++;
+      r = Expr_parse_sum(ps);
+      Expr_skip(ps);
+      if (*ps->s != ')') return Expr_error(ps, "expected ')'");
+      ps->s++;
+      return r;
+   }
+   while (isalpha((unsigned char) ps->s[len]) && len < 15) {
+      name[len] = ps->s[len];
+      len++;
+   }
+   name[len] = '\0';
+   if (len == 0) return Expr_error(ps, "syntax error");
+   ps->s += len;
+
+   if (strcmp(name, "x") == 0) return 0;
+   if (strcmp(name, "pi") == 0) return Expr_const(ps, M_PI);
+   for (k = 0; k < (int) (sizeof(funcs)/sizeof(funcs[0])); k++)
+      if (strcmp(name, funcs[k].name) == 0) {
+         Expr_skip(ps);
+         if (*ps->s != '(') return Expr_error(ps, "expected '('");
+         r = Expr_parse_primary(ps);
+         return Expr_emit(ps, funcs[k].op, r, r);
+      }
+   return Expr_error(ps, "unknown name");
+}  /* Expr_parse_primary */
+
+/* unary := '-' unary | primary ['^' unary] */
+static int Expr_parse_unary(expr_parser_t* ps) {
+   int r;
+
+   Expr_skip(ps);
+   if (*ps->s == '-') {
+      ps->s++;
+      r = Expr_parse_unary(ps);
+      return Expr_emit(ps, EXPR_NEG, r, r);
+   }
+   if (*ps->s == '+') {
+      ps->s++;
+      return Expr_parse_unary(ps);
+   }
+   r = Expr_parse_primary(ps);
+   Expr_skip(ps);
+   if (*ps->s == '^') {
+      ps->s++;
+      r = Expr_emit(ps, EXPR_POW, r, Expr_parse_unary(ps));
+   }
+   return r;
+}  /* Expr_parse_unary */
+
+/* product := unary (('*' | '/') unary)* */
+static int Expr_parse_product(expr_parser_t* ps) {
+   int r, op;
+
+   r = Expr_parse_unary(ps);
+   for (;;) {
+      Expr_skip(ps);
+      if (*ps->s != '*' && *ps->s != '/') return r;
+      op = (*ps->s == '*') ? EXPR_MUL : EXPR_DIV;
+      ps->s++;
+      r = Expr_emit(ps, op, r, Expr_parse_unary(ps));
+   }
+}  /* Expr_parse_product */
+
+/* sum := product (('+' | '-') product)* */
+static int Expr_parse_sum(expr_parser_t* ps) {
+   int r, op;
+
+   r = Expr_parse_product(ps);
+   for (;;) {
+      Expr_skip(ps);
+      if (*ps->s != '+' && *ps->s != '-') return r;
+      op = (*ps->s == '+') ? EXPR_ADD : EXPR_SUB;
+      ps->s++;
+      r = Expr_emit(ps, op, r, Expr_parse_product(ps));
+   }
+}  /* Expr_parse_sum */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_compile
+ * Purpose:     Compile the text of an expression in x
+ * In arg:      text
+ * Out args:    p:    the program
+ *              err:  message if there's an error (EXPR_MAX_TEXT
+ *                    chars)
+ * Return val:  1 if OK, 0 on error (then p->n_instr is
+ *              EXPR_BAD_PROGRAM)
+ * Note:        Constants are collected in a first pass, so that the
+ *              temporaries can start right after them.
+ */
+static int Expr_compile(const char* text, expr_prog_t* p, char* err) {
+   expr_parser_t ps;
+   int pass, r = -1;
+
+   memset(p, 0, sizeof(*p));
+   strncpy(p->text, text, EXPR_MAX_TEXT-1);
+   err[0] = '\0';
+   ps.p = p;
+   ps.err = err;
+
+   /* Pass 0 finds the constants (including folded ones), pass 1
+    * generates the code with the temporaries after them */
+   for (pass = 0; pass < 2; pass++) {
+      p->n_instr = 0;
+      ps.s = text;
+      ps.top = EXPR_MAX_REGS/2;
+      if (pass == 1) ps.top = EXPR_FIRST_TEMP(p);
+      p->n_regs = ps.top;
+      r = Expr_parse_sum(&ps);
+      Expr_skip(&ps);
+      if (r >= 0 && *ps.s != '\0') r = Expr_error(&ps, "unexpected text");
+      if (r < 0) {
+         p->n_instr = EXPR_BAD_PROGRAM;
+         return 0;
+      }
+   }
+   p->result = r;
+
+   return 1;
+}  /* Expr_compile */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_read
+ * Purpose:     Read the rest of the current input line and compile
+ *              it.  A blank line means "no expression".
+ * In arg:      fp
+ * Out args:    p, err (as in Expr_compile)
+ * Return val:  1 if OK or blank, 0 on error
+ */
+static inline int Expr_read(FILE* fp, expr_prog_t* p, char* err) {
+   char line[EXPR_MAX_TEXT];
+   int k;
+
+   err[0] = '\0';
+   if (fgets(line, EXPR_MAX_TEXT, fp) == NULL) line[0] = '\0';
+   line[strcspn(line, "\r\n")] = '\0';
+   for (k = 0; isspace((unsigned char) line[k]); k++)
+      ;
+   if (line[k] == '\0') {
+      memset(p, 0, sizeof(*p));
+      p->n_instr = EXPR_NO_PROGRAM;
+      return 1;
+   }
+   return Expr_compile(line + k, p, err);
+}  /* Expr_read */
+
+/*===================================================================
+ * Interpreter
+ */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_run
+ * Purpose:     Run the program on one block of x values:  on entry
+ *              reg[0] holds the x's and reg[1..n_const] the constants
+ */
+static inline void Expr_run(const expr_prog_t* p,
+      double reg[][EXPR_BLOCK]) {
+   int i, k;
+
+   for (i = 0; i < p->n_instr; i++) {
+      const expr_instr_t* in = &p->code[i];
+      double* d = reg[in->dst];
+      const double* a = reg[in->a];
+      const double* b = reg[in->b];
+      switch (in->op) {
+         case EXPR_ADD:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = a[k] + b[k];
+            break;
+         case EXPR_SUB:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = a[k] - b[k];
+            break;
+         case EXPR_MUL:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = a[k] * b[k];
+            break;
+         case EXPR_DIV:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = a[k] / b[k];
+            break;
+         case EXPR_NEG:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = -a[k];
+            break;
+         case EXPR_ABS:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = fabs(a[k]);
+            break;
+         case EXPR_SQRT:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = sqrt(a[k]);
+            break;
+         case EXPR_EXP:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = exp(a[k]);
+            break;
+         case EXPR_SIN:
+            for (k = 0; k < EXPR_BLOCK; k++) d[k] = sin(a[k]);
+            break;
+         default:
+            for (k = 0; k < EXPR_BLOCK; k++)
+               d[k] = Expr_apply(in->op, a[k], b[k]);
+      }
+   }
+}  /* Expr_run */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_load_consts
+ * Purpose:     Fill registers 1..n_const with the constants
+ */
+static inline void Expr_load_consts(const expr_prog_t* p,
+      double reg[][EXPR_BLOCK]) {
+   int c, k;
+
+   for (c = 0; c < p->n_const; c++)
+      for (k = 0; k < EXPR_BLOCK; k++)
+         reg[1+c][k] = p->consts[c];
+}  /* Expr_load_consts */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_eval
+ * Purpose:     f(x) for a single x (for the endpoints)
+ */
+static inline double Expr_eval(const expr_prog_t* p, double x) {
+   double reg[EXPR_MAX_REGS][EXPR_BLOCK];
+   int k;
+
+   Expr_load_consts(p, reg);
+   for (k = 0; k < EXPR_BLOCK; k++) reg[0][k] = x;
+   Expr_run(p, reg);
+   return reg[p->result][0];
+}  /* Expr_eval */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_trap_sum
+ * Purpose:     Sum of f(x0 + i*h) for i = first, ..., first+count-1,
+ *              like the Trap_sum kernels of trap_simd.h
+ * Note:        Compiled for AVX-512, AVX2 and plain x86-64; the
+ *              version is picked when the program starts.
+ */
+__attribute__ ((target_clones ("avx512f", "avx2", "default")))
+static double Expr_trap_sum(const expr_prog_t* p, double x0, double h,
+      long first, long count) {
+   double reg[EXPR_MAX_REGS][EXPR_BLOCK] __attribute__ ((aligned (64)));
+   double acc[EXPR_BLOCK] = {0.0};
+   double sum = 0.0;
+   long i, last = first + count;
+   int k, valid;
+
+   Expr_load_consts(p, reg);
+   for (i = first; i < last; i += EXPR_BLOCK) {
+      valid = (last - i < EXPR_BLOCK) ? (int) (last - i) : EXPR_BLOCK;
+      for (k = 0; k < EXPR_BLOCK; k++)   /* Extra lanes repeat x0 */
+         reg[0][k] = x0 + (k < valid ? (double) (i + k)*h : 0.0);
+      Expr_run(p, reg);
+      if (valid == EXPR_BLOCK)
+         for (k = 0; k < EXPR_BLOCK; k++) acc[k] += reg[p->result][k];
+      else
+         for (k = 0; k < valid; k++) acc[k] += reg[p->result][k];
+   }
+   for (k = 0; k < EXPR_BLOCK; k++)
+      sum += acc[k];
+
+   return sum;
+}  /* Expr_trap_sum */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_trap_sum_comp
+ * Purpose:     Same as Expr_trap_sum, but each lane keeps the rounding
+ *              errors of its additions (TwoSum) and adds them back at
+ *              the end
+ */
+__attribute__ ((target_clones ("avx512f", "avx2", "default")))
+static double Expr_trap_sum_comp(const expr_prog_t* p, double x0,
+      double h, long first, long count) {
+   double reg[EXPR_MAX_REGS][EXPR_BLOCK] __attribute__ ((aligned (64)));
+   double acc[EXPR_BLOCK] = {0.0}, err[EXPR_BLOCK] = {0.0};
+   double sum = 0.0, comp = 0.0, y, t, z;
+   long i, last = first + count;
+   int k, valid;
+
+   Expr_load_consts(p, reg);
+   for (i = first; i < last; i += EXPR_BLOCK) {
+      valid = (last - i < EXPR_BLOCK) ? (int) (last - i) : EXPR_BLOCK;
+      for (k = 0; k < EXPR_BLOCK; k++)
+         reg[0][k] = x0 + (k < valid ? (double) (i + k)*h : 0.0);
+      Expr_run(p, reg);
+      for (k = 0; k < EXPR_BLOCK; k++) {
+         y = (k < valid) ? reg[p->result][k] : 0.0;
+         TRAP_TWO_SUM(acc[k], err[k], y, t, z);
+      }
+   }
+   for (k = 0; k < EXPR_BLOCK; k++) {
+      TRAP_TWO_SUM(sum, comp, acc[k], t, z);
+      comp += err[k];
+   }
+
+   return sum + comp;
+}  /* Expr_trap_sum_comp */
+
+/*===================================================================
+ * As an integrand_t
+ */
+static const expr_prog_t* expr_current = NULL;
+
+static inline double Expr_f(double x) {
+   return Expr_eval(expr_current, x);
+}  /* Expr_f */
+
+static inline void Expr_f_batch(const double x[], double y[], long n) {
+   double reg[EXPR_MAX_REGS][EXPR_BLOCK];
+   long i;
+   int k, valid;
+
+   Expr_load_consts(expr_current, reg);
+   for (i = 0; i < n; i += EXPR_BLOCK) {
+      valid = (n - i < EXPR_BLOCK) ? (int) (n - i) : EXPR_BLOCK;
+      for (k = 0; k < EXPR_BLOCK; k++)
+         reg[0][k] = x[i + (k < valid ? k : 0)];
+      Expr_run(expr_current, reg);
+      for (k = 0; k < valid; k++)
+         y[i+k] = reg[expr_current->result][k];
+   }
+}  /* Expr_f_batch */
+
+static inline double Expr_trap_sum_current(double x0, double h,
+      long first, long count) {
+   return Expr_trap_sum(expr_current, x0, h, first, count);
+}  /* Expr_trap_sum_current */
+
+static inline double Expr_trap_sum_comp_current(double x0, double h,
+      long first, long count) {
+   return Expr_trap_sum_comp(expr_current, x0, h, first, count);
+}  /* Expr_trap_sum_comp_current */
+
+static inline double Expr_trap_sum_pairwise_current(double x0, double h,
+      long first, long count) {
+   return Trap_sum_pairwise(Expr_trap_sum_current, x0, h, first, count);
+}  /* Expr_trap_sum_pairwise_current */
+
+/*-------------------------------------------------------------------
+ * Function:    Expr_integrand
+ * Purpose:     Make p the integrand of this process
+ * Return val:  an integrand_t whose functions run p
+ * Note:        There is only one such integrand per process:  a new
+ *              call replaces the program of the previous one.
+ */
+static inline const integrand_t* Expr_integrand(const expr_prog_t* p) {
+   static integrand_t fn;
+
+   expr_current = p;
+   fn.name = "expr";
+   fn.formula = p->text;
+   fn.f = Expr_f;
+   fn.f_batch = Expr_f_batch;
+   fn.trap_sum = Expr_trap_sum_current;
+   fn.trap_sum_comp = Expr_trap_sum_comp_current;
+   fn.trap_sum_pairwise = Expr_trap_sum_pairwise_current;
+   fn.primitive = NULL;
+   return &fn;
+}  /* Expr_integrand */
+
+/*===================================================================
+ * Communication
+ */
+#ifdef MPI_VERSION
+/*-------------------------------------------------------------------
+ * Function:    Expr_bcast
+ * Purpose:     Send the program on root to every process in comm.
+ *              Only the used part of the tables is sent;  the source
+ *              text is sent too, since it is the integrand's formula
+ *              (e.g. in the checkpoint key of every process).
+ */
+static inline void Expr_bcast(expr_prog_t* p, int root, MPI_Comm comm) {
+   int header[4];
+
+   header[0] = p->n_instr;
+   header[1] = p->n_const;
+   header[2] = p->n_regs;
+   header[3] = p->result;
+   MPI_Bcast(header, 4, MPI_INT, root, comm);
+   p->n_instr = header[0];
+   p->n_const = header[1];
+   p->n_regs  = header[2];
+   p->result  = header[3];
+   if (p->n_instr < 0) return;
+
+   MPI_Bcast(p->code, p->n_instr*(int) sizeof(expr_instr_t), MPI_BYTE,
+         root, comm);
+   MPI_Bcast(p->consts, p->n_const, MPI_DOUBLE, root, comm);
+   MPI_Bcast(p->text, EXPR_MAX_TEXT, MPI_CHAR, root, comm);
+}  /* Expr_bcast */
+#endif
+
+#endif /* _EXPR_H_ */
@@ -0,0 +1,219 @@
+/* File:     integrands.h
+ *
+ * Purpose:  Library of functions to integrate, so the trapezoidal rule
+ *           programs don't need f(x) hardwired.  The integrand is
+ *           chosen at run time by name, e.g.
+ *
+ *              const integrand_t* fn = Integrand_find("gauss");
+ *              sum = fn->trap_sum(a, h, 1, n-1);
+ *
+ *           For each integrand <name> this header defines
+ *
+ *              f_<name>(x)              the function itself
+ *              f_<name>_batch(x, y, n)  y[i] = f(x[i]), i = 0..n-1
+ *              Trap_sum_<name>(...)     the SIMD kernel of trap_simd.h
+ *                                       (and its _comp and _pairwise
+ *                                       variants)
+ *
+ *           Each of them is compiled separately with the formula
+ *           inlined, so choosing the integrand at run time costs one
+ *           call through a pointer per Trap, not one per sample.
+ *
+ * Adding an integrand:
+ *    1.  #define F_<name>(x) with its formula
+ *    2.  INTEGRAND_DEFINE(<name>) and include trap_simd.h with
+ *        TRAP_SIMD_F(x) = F_<name>(x) (and TRAP_SIMD_LANEWISE if the
+ *        formula calls the math library)
+ *    3.  Add a line to integrand_table (and its primitive, if known)
+ *
+ * Note:     Link with -lm.
+ */
+#ifndef _INTEGRANDS_H_
+#define _INTEGRANDS_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct {
+   const char* name;
+   const char* formula;
+   double (*f)(double x);
+   void   (*f_batch)(const double x[], double y[], long n);
+   double (*trap_sum)(double x0, double h, long first, long count);
+   double (*trap_sum_comp)(double x0, double h, long first, long count);
+   double (*trap_sum_pairwise)(double x0, double h, long first,
+         long count);
+   double (*primitive)(double x);   /* NULL if not known */
+} integrand_t;
+
+#define INTEGRAND_DEFINE(name)                                        \
+static inline double f_##name(double x) {                            \
+   return F_##name(x);                                                \
+}                                                                     \
+static inline void f_##name##_batch(const double x[], double y[],    \
+      long n) {                                                       \
+   long i;                                                            \
+   for (i = 0; i < n; i++)                                            \
+      y[i] = F_##name(x[i]);                                          \
+}
+
+/*--------------------------------------------------------------------
+ * Polynomials
+ */
+#define F_quad(x)   ((x)*(x))
+INTEGRAND_DEFINE(quad)
+#define TRAP_SIMD_F(x)  F_quad(x)
+#define TRAP_SIMD_NAME  quad
+#include "trap_simd.h"
+
+#define F_cubic(x)  ((x)*(x)*(x) - 2.0*(x) + 1.0)
+INTEGRAND_DEFINE(cubic)
+#define TRAP_SIMD_F(x)  F_cubic(x)
+#define TRAP_SIMD_NAME  cubic
+#include "trap_simd.h"
+
+/* Taylor polynomial of degree 4 of exp(x), in Horner form */
+#define F_poly4(x) \
+   (1.0 + (x)*(1.0 + (x)*(1.0/2.0 + (x)*(1.0/6.0 + (x)*(1.0/24.0)))))
+INTEGRAND_DEFINE(poly4)
+#define TRAP_SIMD_F(x)  F_poly4(x)
+#define TRAP_SIMD_NAME  poly4
+#include "trap_simd.h"
+
+/*--------------------------------------------------------------------
+ * Rational functions
+ */
+#define F_lorentz(x)  (1.0/(1.0 + (x)*(x)))
+INTEGRAND_DEFINE(lorentz)
+#define TRAP_SIMD_F(x)  F_lorentz(x)
+#define TRAP_SIMD_NAME  lorentz
+#include "trap_simd.h"
+
+#define F_runge(x)  (1.0/(1.0 + 25.0*(x)*(x)))
+INTEGRAND_DEFINE(runge)
+#define TRAP_SIMD_F(x)  F_runge(x)
+#define TRAP_SIMD_NAME  runge
+#include "trap_simd.h"
+
+/* Narrow peak at x = 0.3 (width 0.01) */
+#define F_peak(x)  (1.0/(((x) - 0.3)*((x) - 0.3) + 1.0e-4))
+INTEGRAND_DEFINE(peak)
+#define TRAP_SIMD_F(x)  F_peak(x)
+#define TRAP_SIMD_NAME  peak
+#include "trap_simd.h"
+
+/*--------------------------------------------------------------------
+ * Transcendental functions
+ */
+#define F_exp(x)  exp(x)
+INTEGRAND_DEFINE(exp)
+#define TRAP_SIMD_F(x)  F_exp(x)
+#define TRAP_SIMD_NAME  exp
+#define TRAP_SIMD_LANEWISE
+#include "trap_simd.h"
+
+#define F_gauss(x)  exp(-(x)*(x))
+INTEGRAND_DEFINE(gauss)
+#define TRAP_SIMD_F(x)  F_gauss(x)
+#define TRAP_SIMD_NAME  gauss
+#define TRAP_SIMD_LANEWISE
+#include "trap_simd.h"
+
+#define F_sin(x)  sin(x)
+INTEGRAND_DEFINE(sin)
+#define TRAP_SIMD_F(x)  F_sin(x)
+#define TRAP_SIMD_NAME  sin
+#define TRAP_SIMD_LANEWISE
+#include "trap_simd.h"
+
+#define F_damped(x)  (sin(x)*exp(-(x)))
+INTEGRAND_DEFINE(damped)
+#define TRAP_SIMD_F(x)  F_damped(x)
+#define TRAP_SIMD_NAME  damped
+#define TRAP_SIMD_LANEWISE
+#include "trap_simd.h"
+
+/*--------------------------------------------------------------------
+ * Primitives, used to print the error of an estimate
+ */
+static inline double P_quad(double x)    { return x*x*x/3.0; }
+static inline double P_cubic(double x)   { return x*x*x*x/4.0 - x*x + x; }
+static inline double P_poly4(double x) {
+   return x*(1.0 + x*(1.0/2.0 + x*(1.0/6.0 + x*(1.0/24.0 + x/120.0))));
+}
+static inline double P_lorentz(double x) { return atan(x); }
+static inline double P_runge(double x)   { return atan(5.0*x)/5.0; }
+static inline double P_peak(double x)    { return atan((x - 0.3)/0.01)/0.01; }
+static inline double P_exp(double x)     { return exp(x); }
+static inline double P_gauss(double x)   { return sqrt(M_PI)/2.0*erf(x); }
+static inline double P_sin(double x)     { return -cos(x); }
+static inline double P_damped(double x) {
+   return -exp(-x)*(sin(x) + cos(x))/2.0;
+}
+
+#define INTEGRAND_ENTRY(name, formula) \
+   {#name, formula, f_##name, f_##name##_batch, Trap_sum_##name, \
+      Trap_sum_##name##_comp, Trap_sum_##name##_pairwise, P_##name}
+
+static const integrand_t integrand_table[] = {
+   INTEGRAND_ENTRY(quad,    "x^2"),
+   INTEGRAND_ENTRY(cubic,   "x^3 - 2x + 1"),
+   INTEGRAND_ENTRY(poly4,   "1 + x + x^2/2 + x^3/6 + x^4/24"),
+   INTEGRAND_ENTRY(lorentz, "1/(1 + x^2)"),
+   INTEGRAND_ENTRY(runge,   "1/(1 + 25x^2)"),
+   INTEGRAND_ENTRY(peak,    "1/((x - 0.3)^2 + 1e-4)"),
+   INTEGRAND_ENTRY(exp,     "exp(x)"),
+   INTEGRAND_ENTRY(gauss,   "exp(-x^2)"),
+   INTEGRAND_ENTRY(sin,     "sin(x)"),
+   INTEGRAND_ENTRY(damped,  "sin(x)*exp(-x)"),
+};
+
+#define INTEGRAND_COUNT \
+   ((int) (sizeof(integrand_table)/sizeof(integrand_table[0])))
+
+#define INTEGRAND_DEFAULT "quad"
+
+/*-------------------------------------------------------------------
+ * Function:    Integrand_find
+ * Purpose:     Look up an integrand by name
+ * In arg:      name:  e.g. "gauss" (NULL gives INTEGRAND_DEFAULT)
+ * Return val:  pointer into integrand_table, or NULL if there is no
+ *              integrand with that name
+ */
+static inline const integrand_t* Integrand_find(const char* name) {
+   int i;
+
+   if (name == NULL) name = INTEGRAND_DEFAULT;
+   for (i = 0; i < INTEGRAND_COUNT; i++)
+      if (strcmp(integrand_table[i].name, name) == 0)
+         return &integrand_table[i];
+   return NULL;
+}  /* Integrand_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Integrand_list
+ * Purpose:     Print the names and formulas of the integrands (for
+ *              the Usage functions)
+ */
+static inline void Integrand_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   integrands:\n");
+   for (i = 0; i < INTEGRAND_COUNT; i++)
+      fprintf(fp, "      %-8s %s\n", integrand_table[i].name,
+            integrand_table[i].formula);
+}  /* Integrand_list */
+
+/*-------------------------------------------------------------------
+ * Function:    Integrand_exact
+ * Purpose:     Exact integral of fn from a to b, from its primitive
+ * Return val:  the integral, or NAN if the primitive is not known
+ */
+static inline double Integrand_exact(const integrand_t* fn, double a,
+      double b) {
+   if (fn->primitive == NULL) return NAN;
+   return fn->primitive(b) - fn->primitive(a);
+}  /* Integrand_exact */
+
+#endif /* _INTEGRANDS_H_ */
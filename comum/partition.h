@@ -0,0 +1,131 @@
+/* File:     partition.h
+ *
+ * Purpose:  Split n trapezoids (or panels, or points) among the
+ *           threads or processes of a program, for any n and any
+ *           number of workers:
+ *
+ *              part_t part = Partition(n, my_rank, comm_sz, PART_ALIGN);
+ *              local_a = Part_left(a, h, part);
+ *              local_b = Part_right(a, h, part);
+ *              local_int = Trap(local_a, local_b, part.count, h, fn);
+ *
+ * Notes:
+ *   1.  Counts are long (64 bits), so n can go past 2^31.
+ *   2.  The work is dealt in units of align items.  Every worker gets
+ *       n_units/workers units, and the first n_units % workers
+ *       workers get one more;  the last worker also gets the
+ *       n % align items that don't fill a unit.  So the sizes differ
+ *       by at most align items, and no worker is left idle unless
+ *       n < workers*align.
+ *   3.  With align = PART_ALIGN (8 doubles = one cache line = one
+ *       AVX-512 vector) every chunk starts on a multiple of 8:  the
+ *       vector iterations of the SIMD kernels fall on the same grid
+ *       in every worker, and chunks of arrays of doubles that start
+ *       on a cache line boundary don't share lines with their
+ *       neighbours.  align = 1 gives the usual block partition.
+ *   4.  The endpoints of a chunk are computed from its first index,
+ *       a + first*h, not by adding up the lengths of the chunks
+ *       before it, so neighbouring chunks agree exactly on their
+ *       common endpoint.
+ *   5.  Weighted_partition deals the units in proportion to a weight
+ *       per worker (e.g. its measured samples per second), for
+ *       workers that don't run at the same speed.  Every worker must
+ *       pass the same array of weights:  each chunk ends where the
+ *       next one starts, because both are computed from the same
+ *       running sum of the weights.
+ */
+#ifndef _PARTITION_H_
+#define _PARTITION_H_
+
+#define PART_ALIGN 8
+
+typedef struct {
+   long first;   /* Index of my first item */
+   long count;   /* Number of items I get  */
+} part_t;
+
+/*-------------------------------------------------------------------
+ * Function:    Partition
+ * Purpose:     Find the chunk of items 0..n-1 that belongs to worker
+ *              my_rank of workers
+ * In args:     n:        number of items
+ *              my_rank:  0 <= my_rank < workers
+ *              workers:  number of threads or processes
+ *              align:    chunk starts are multiples of align (>= 1)
+ * Return val:  my chunk (count may be 0)
+ */
+static inline part_t Partition(long n, int my_rank, int workers,
+      long align) {
+   part_t part;
+   long units, quotient, remainder, my_units;
+
+   if (align < 1) align = 1;
+   units = n/align;
+   quotient = units/workers;
+   remainder = units%workers;
+
+   if (my_rank < remainder) {
+      my_units = quotient + 1;
+      part.first = my_rank*(quotient + 1)*align;
+   } else {
+      my_units = quotient;
+      part.first = (my_rank*quotient + remainder)*align;
+   }
+   part.count = my_units*align;
+   if (my_rank == workers-1) part.count += n - units*align;
+
+   return part;
+}  /* Partition */
+
+/*-------------------------------------------------------------------
+ * Function:    Weighted_partition
+ * Purpose:     Find the chunk of items 0..n-1 that belongs to worker
+ *              my_rank, with chunk sizes proportional to weight[]
+ * In args:     n, my_rank, workers, align:  as in Partition
+ *              weight:  weight[q] >= 0 for q = 0, ..., workers-1
+ * Return val:  my chunk (count may be 0).  If all the weights are 0
+ *              the result is Partition's.
+ */
+static inline part_t Weighted_partition(long n, int my_rank, int workers,
+      const double weight[], long align) {
+   part_t part;
+   double total = 0.0, before = 0.0, after = 0.0;
+   long units, first_unit, end_unit;
+   int q;
+
+   for (q = 0; q < workers; q++) {
+      if (q == my_rank) before = total;
+      if (weight[q] > 0.0) total += weight[q];
+      if (q == my_rank) after = total;
+   }
+   if (total <= 0.0) return Partition(n, my_rank, workers, align);
+
+   if (align < 1) align = 1;
+   units = n/align;
+   first_unit = (long) (units*(before/total) + 0.5);
+   end_unit = (my_rank == workers-1)
+      ? units : (long) (units*(after/total) + 0.5);
+   if (end_unit > units) end_unit = units;
+   if (first_unit > end_unit) first_unit = end_unit;
+
+   part.first = first_unit*align;
+   part.count = (end_unit - first_unit)*align;
+   if (my_rank == workers-1) part.count += n - units*align;
+
+   return part;
+}  /* Weighted_partition */
+
+/*-------------------------------------------------------------------
+ * Function:    Part_left, Part_right
+ * Purpose:     Endpoints of a chunk of trapezoids of width h starting
+ *              at a
+ */
+static inline double Part_left(double a, double h, part_t part) {
+   return a + part.first*h;
+}  /* Part_left */
+
+static inline double Part_right(double a, double h, part_t part) {
+   return a + (part.first + part.count)*h;
+}  /* Part_right */
+
+#endif /* _PARTITION_H_ */
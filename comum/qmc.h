@@ -0,0 +1,253 @@
+/* File:     qmc.h
+ *
+ * Purpose:  Pieces of a Monte Carlo / quasi-Monte Carlo integrator
+ *           over the cube [a, b]^d, for dimensions where the grids of
+ *           the trapezoidal rule get too big:
+ *
+ *              Sobol sequence    low discrepancy points, randomized by
+ *                                a digital shift per replicate
+ *              counter RNG       pseudo-random point i is a hash of
+ *                                (seed, i), so there is no state
+ *              integrands        functions of d variables, with exact
+ *                                integrals for checking
+ *
+ *           Both generators give point i directly, so each thread or
+ *           process can start at its own index without any shared
+ *           state:
+ *
+ *              sobol_t sobol;                (read-only, shared)
+ *              sobol_point_t pt;             (one per worker)
+ *              Sobol_init(&sobol, d);
+ *              Sobol_seek(&sobol, &pt, first);
+ *              for (i = first; i < first + count; i++) {
+ *                 ...use pt.x...
+ *                 Sobol_next(&sobol, &pt);
+ *              }
+ *
+ * Notes:
+ *   1.  The direction numbers are the first QMC_MAX_DIM dimensions of
+ *       Joe and Kuo's table (new-joe-kuo-6.21201), with 32 bits, so a
+ *       sequence has at most 2^32 points.
+ *   2.  The randomization is a random digital shift (XOR with a
+ *       random 32-bit value per dimension), not a full Owen
+ *       scrambling.  Independent shifts give independent replicates
+ *       of the QMC estimate, whose spread gives the error.
+ *   3.  Rng_u64 is the splitmix64 finalizer applied to seed + i*golden
+ *       ratio:  good enough for Monte Carlo, not for cryptography.
+ */
+#ifndef _QMC_H_
+#define _QMC_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define QMC_MAX_DIM  16
+#define QMC_BITS     32
+
+typedef struct {
+   int      dim;
+   unsigned v[QMC_MAX_DIM][QMC_BITS];   /* Direction numbers */
+} sobol_t;
+
+typedef struct {
+   long     index;                      /* Index of x         */
+   unsigned x[QMC_MAX_DIM];             /* Point, as integers */
+} sobol_point_t;
+
+/* Joe-Kuo:  degree s, coefficients a, initial m_1..m_s of dimensions
+ * 2..QMC_MAX_DIM (dimension 1 is the van der Corput sequence) */
+static const struct {int s, a, m[6];} sobol_init_table[QMC_MAX_DIM-1] = {
+   {1,  0, {1}},
+   {2,  1, {1, 3}},
+   {3,  1, {1, 3, 1}},
+   {3,  2, {1, 1, 1}},
+   {4,  1, {1, 1, 3, 3}},
+   {4,  4, {1, 3, 5, 13}},
+   {5,  2, {1, 1, 5, 5, 17}},
+   {5,  4, {1, 1, 5, 5, 5}},
+   {5,  7, {1, 1, 7, 11, 19}},
+   {5, 11, {1, 1, 5, 1, 1}},
+   {5, 13, {1, 1, 1, 3, 11}},
+   {5, 14, {1, 3, 5, 5, 31}},
+   {6,  1, {1, 3, 3, 9, 7, 49}},
+   {6, 13, {1, 1, 1, 15, 21, 21}},
+   {6, 16, {1, 3, 1, 13, 27, 49}},
+};
+
+/*-------------------------------------------------------------------
+ * Function:    Sobol_init
+ * Purpose:     Compute the direction numbers of the first dim
+ *              dimensions (dim <= QMC_MAX_DIM)
+ */
+static inline void Sobol_init(sobol_t* sobol, int dim) {
+   int d, k, i, s, a;
+
+   sobol->dim = dim;
+   for (k = 0; k < QMC_BITS; k++)
+      sobol->v[0][k] = 1u << (QMC_BITS - 1 - k);
+   for (d = 1; d < dim; d++) {
+      s = sobol_init_table[d-1].s;
+      a = sobol_init_table[d-1].a;
+      for (k = 0; k < s && k < QMC_BITS; k++)
+         sobol->v[d][k] = (unsigned) sobol_init_table[d-1].m[k]
+            << (QMC_BITS - 1 - k);
+      for (k = s; k < QMC_BITS; k++) {
+         sobol->v[d][k] = sobol->v[d][k-s] ^ (sobol->v[d][k-s] >> s);
+         for (i = 1; i < s; i++)
+            if ((a >> (s - 1 - i)) & 1)
+               sobol->v[d][k] ^= sobol->v[d][k-i];
+      }
+   }
+}  /* Sobol_init */
+
+/*-------------------------------------------------------------------
+ * Function:    Sobol_seek
+ * Purpose:     Jump to point index of the sequence (Gray code order):
+ *              QMC_BITS operations per dimension
+ */
+static inline void Sobol_seek(const sobol_t* sobol, sobol_point_t* pt,
+      long index) {
+   unsigned long gray = (unsigned long) index ^ ((unsigned long) index >> 1);
+   int d, k;
+
+   pt->index = index;
+   for (d = 0; d < sobol->dim; d++) {
+      pt->x[d] = 0;
+      for (k = 0; k < QMC_BITS; k++)
+         if ((gray >> k) & 1) pt->x[d] ^= sobol->v[d][k];
+   }
+}  /* Sobol_seek */
+
+/*-------------------------------------------------------------------
+ * Function:    Sobol_next
+ * Purpose:     Go to the next point:  one XOR per dimension
+ * Note:        pt->index must be less than 2^QMC_BITS - 1, the last
+ *              point of the sequence
+ */
+static inline void Sobol_next(const sobol_t* sobol, sobol_point_t* pt) {
+   int c = __builtin_ctzl(~(unsigned long) pt->index), d;
+
+   for (d = 0; d < sobol->dim; d++)
+      pt->x[d] ^= sobol->v[d][c];
+   pt->index++;
+}  /* Sobol_next */
+
+/*-------------------------------------------------------------------
+ * Function:    Rng_u64
+ * Purpose:     64 random bits for counter i of stream seed
+ */
+static inline unsigned long long Rng_u64(unsigned long long seed,
+      unsigned long long i) {
+   unsigned long long z = seed + (i + 1)*0x9e3779b97f4a7c15ULL;
+
+   z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+   z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+   return z ^ (z >> 31);
+}  /* Rng_u64 */
+
+/*-------------------------------------------------------------------
+ * Function:    Rng_uniform
+ * Purpose:     Uniform double in (0, 1) for counter i of stream seed
+ */
+static inline double Rng_uniform(unsigned long long seed,
+      unsigned long long i) {
+   return ((Rng_u64(seed, i) >> 11) + 0.5)*(1.0/9007199254740992.0);
+}  /* Rng_uniform */
+
+/*-------------------------------------------------------------------
+ * Function:    Qmc_unit
+ * Purpose:     Integer coordinate (shifted) to a double in (0, 1)
+ */
+static inline double Qmc_unit(unsigned x, unsigned shift) {
+   return ((x ^ shift) + 0.5)*(1.0/4294967296.0);
+}  /* Qmc_unit */
+
+/*--------------------------------------------------------------------
+ * Integrands of d variables
+ */
+typedef struct {
+   const char* name;
+   const char* formula;
+   double (*f)(const double x[], int dim);
+   double (*exact)(double a, double b, int dim);   /* over [a, b]^dim */
+} qmc_integrand_t;
+
+static double Qmc_f_gauss(const double x[], int dim) {
+   double r2 = 0.0;
+   int d;
+
+   for (d = 0; d < dim; d++)
+      r2 += x[d]*x[d];
+   return exp(-r2);
+}  /* Qmc_f_gauss */
+
+static double Qmc_exact_gauss(double a, double b, int dim) {
+   return pow(sqrt(M_PI)/2.0*(erf(b) - erf(a)), dim);
+}  /* Qmc_exact_gauss */
+
+static double Qmc_f_cosprod(const double x[], int dim) {
+   double prod = 1.0;
+   int d;
+
+   for (d = 0; d < dim; d++)
+      prod *= cos(x[d]);
+   return prod;
+}  /* Qmc_f_cosprod */
+
+static double Qmc_exact_cosprod(double a, double b, int dim) {
+   return pow(sin(b) - sin(a), dim);
+}  /* Qmc_exact_cosprod */
+
+static double Qmc_f_sumsq(const double x[], int dim) {
+   double sum = 0.0;
+   int d;
+
+   for (d = 0; d < dim; d++)
+      sum += x[d]*x[d];
+   return sum;
+}  /* Qmc_f_sumsq */
+
+static double Qmc_exact_sumsq(double a, double b, int dim) {
+   return dim*(b*b*b - a*a*a)/3.0*pow(b - a, dim - 1);
+}  /* Qmc_exact_sumsq */
+
+static const qmc_integrand_t qmc_table[] = {
+   {"gauss",   "exp(-(x1^2 + ... + xd^2))", Qmc_f_gauss,   Qmc_exact_gauss},
+   {"cosprod", "cos(x1)*...*cos(xd)",       Qmc_f_cosprod, Qmc_exact_cosprod},
+   {"sumsq",   "x1^2 + ... + xd^2",         Qmc_f_sumsq,   Qmc_exact_sumsq},
+};
+
+#define QMC_COUNT ((int) (sizeof(qmc_table)/sizeof(qmc_table[0])))
+#define QMC_DEFAULT "gauss"
+
+/*-------------------------------------------------------------------
+ * Function:    Qmc_find
+ * Purpose:     Look up an integrand by name (NULL gives QMC_DEFAULT)
+ * Return val:  pointer into qmc_table, or NULL
+ */
+static inline const qmc_integrand_t* Qmc_find(const char* name) {
+   int i;
+
+   if (name == NULL) name = QMC_DEFAULT;
+   for (i = 0; i < QMC_COUNT; i++)
+      if (strcmp(qmc_table[i].name, name) == 0)
+         return &qmc_table[i];
+   return NULL;
+}  /* Qmc_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Qmc_list
+ * Purpose:     Print the integrands (for the Usage functions)
+ */
+static inline void Qmc_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   integrands:\n");
+   for (i = 0; i < QMC_COUNT; i++)
+      fprintf(fp, "      %-8s %s\n", qmc_table[i].name,
+            qmc_table[i].formula);
+   fprintf(fp, "   methods: sobol mc\n");
+}  /* Qmc_list */
+
+#endif /* _QMC_H_ */
@@ -0,0 +1,230 @@
+/* File:     quad_rules.h
+ *
+ * Purpose:  Composite quadrature rules that plug into the same
+ *           local_a/local_b/local_n decomposition as Trap:  the
+ *           trapezoidal rule, Simpson's rule, Boole's rule and
+ *           Gauss-Legendre rules with 2 to 6 points.  The interval
+ *           [left, right] is cut into n "panels" of width H, and the
+ *           rule is applied to each panel.
+ *
+ * Usage:    const quad_rule_t* rule = Rule_find("simpson");
+ *           local_int = Rule_panels(rule, fn, local_a, local_b,
+ *                 local_n, h);
+ *
+ * Notes:
+ *   1.  The tables of nodes (as fractions of the panel, in [0, 1])
+ *       and weights (summing to 1) are constant expressions, so they
+ *       are computed by the compiler.
+ *   2.  Every node k of a rule is at the same offset in every panel,
+ *       so the samples of node k form a grid of spacing H.  Each
+ *       grid is summed by the integrand's SIMD kernel (fn->trap_sum),
+ *       with its weight applied once at the end.
+ *   3.  For Simpson and Boole the samples on the panel boundaries
+ *       are shared by neighbouring panels, as in the trapezoidal
+ *       rule.
+ *   4.  Error for smooth f:  trap O(H^2), simpson O(H^4), boole
+ *       O(H^6), gaussK O(H^(2K)).
+ *   5.  Rule_panels_repro is the version for the repro summation mode
+ *       (comum/summation.h):  the samples are taken on the global
+ *       grids, from a, and each panel boundary is counted by exactly
+ *       one worker, so the result doesn't depend on the partition.
+ */
+#ifndef _QUAD_RULES_H_
+#define _QUAD_RULES_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "integrands.h"
+#include "summation.h"
+#include "partition.h"
+
+typedef struct {
+   const char*   name;
+   const char*   panels;    /* For printing "n = ... <panels>" */
+   int           closed;    /* Nodes 0 and 1 are panel endpoints */
+   int           points;    /* Nodes per panel                   */
+   const double* node;
+   const double* weight;
+} quad_rule_t;
+
+/* Closed Newton-Cotes rules */
+static const double rule_trap_x[]    = {0.0, 1.0};
+static const double rule_trap_w[]    = {1.0/2.0, 1.0/2.0};
+static const double rule_simpson_x[] = {0.0, 1.0/2.0, 1.0};
+static const double rule_simpson_w[] = {1.0/6.0, 4.0/6.0, 1.0/6.0};
+static const double rule_boole_x[]   = {0.0, 1.0/4.0, 2.0/4.0, 3.0/4.0, 1.0};
+static const double rule_boole_w[]   =
+   {7.0/90.0, 32.0/90.0, 12.0/90.0, 32.0/90.0, 7.0/90.0};
+
+/* Gauss-Legendre:  node t in [-1, 1] with weight w becomes node
+ * (1 + t)/2 in [0, 1] with weight w/2 */
+#define GL_X(t) ((1.0 + (t))/2.0)
+#define GL_W(w) ((w)/2.0)
+
+static const double rule_gauss2_x[] = {
+   GL_X(-0.5773502691896257645), GL_X(0.5773502691896257645)};
+static const double rule_gauss2_w[] = {GL_W(1.0), GL_W(1.0)};
+
+static const double rule_gauss3_x[] = {
+   GL_X(-0.7745966692414833770), GL_X(0.0), GL_X(0.7745966692414833770)};
+static const double rule_gauss3_w[] = {
+   GL_W(5.0/9.0), GL_W(8.0/9.0), GL_W(5.0/9.0)};
+
+static const double rule_gauss4_x[] = {
+   GL_X(-0.8611363115940525752), GL_X(-0.3399810435848562648),
+   GL_X( 0.3399810435848562648), GL_X( 0.8611363115940525752)};
+static const double rule_gauss4_w[] = {
+   GL_W(0.3478548451374538574), GL_W(0.6521451548625461426),
+   GL_W(0.6521451548625461426), GL_W(0.3478548451374538574)};
+
+static const double rule_gauss5_x[] = {
+   GL_X(-0.9061798459386639928), GL_X(-0.5384693101056830910),
+   GL_X(0.0),
+   GL_X( 0.5384693101056830910), GL_X( 0.9061798459386639928)};
+static const double rule_gauss5_w[] = {
+   GL_W(0.2369268850561890875), GL_W(0.4786286704993664680),
+   GL_W(0.5688888888888888889),
+   GL_W(0.4786286704993664680), GL_W(0.2369268850561890875)};
+
+static const double rule_gauss6_x[] = {
+   GL_X(-0.9324695142031520278), GL_X(-0.6612093864662645137),
+   GL_X(-0.2386191860831969086),
+   GL_X( 0.2386191860831969086),
+   GL_X( 0.6612093864662645137), GL_X( 0.9324695142031520278)};
+static const double rule_gauss6_w[] = {
+   GL_W(0.1713244923791703450), GL_W(0.3607615730481386076),
+   GL_W(0.4679139345726910474),
+   GL_W(0.4679139345726910474),
+   GL_W(0.3607615730481386076), GL_W(0.1713244923791703450)};
+
+#define RULE_ENTRY(name, panels, closed, points) \
+   {#name, panels, closed, points, rule_##name##_x, rule_##name##_w}
+
+static const quad_rule_t rule_table[] = {
+   RULE_ENTRY(trap,    "trapezoids",          1, 2),
+   RULE_ENTRY(simpson, "Simpson panels",      1, 3),
+   RULE_ENTRY(boole,   "Boole panels",        1, 5),
+   RULE_ENTRY(gauss2,  "2-point Gauss panels", 0, 2),
+   RULE_ENTRY(gauss3,  "3-point Gauss panels", 0, 3),
+   RULE_ENTRY(gauss4,  "4-point Gauss panels", 0, 4),
+   RULE_ENTRY(gauss5,  "5-point Gauss panels", 0, 5),
+   RULE_ENTRY(gauss6,  "6-point Gauss panels", 0, 6),
+};
+
+#define RULE_COUNT ((int) (sizeof(rule_table)/sizeof(rule_table[0])))
+#define RULE_DEFAULT "trap"
+
+/*-------------------------------------------------------------------
+ * Function:    Rule_find
+ * Purpose:     Look up a rule by name
+ * In arg:      name:  e.g. "simpson" (NULL gives RULE_DEFAULT)
+ * Return val:  pointer into rule_table, or NULL if not found
+ */
+static inline const quad_rule_t* Rule_find(const char* name) {
+   int i;
+
+   if (name == NULL) name = RULE_DEFAULT;
+   for (i = 0; i < RULE_COUNT; i++)
+      if (strcmp(rule_table[i].name, name) == 0)
+         return &rule_table[i];
+   return NULL;
+}  /* Rule_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Rule_list
+ * Purpose:     Print the names of the rules (for the Usage functions)
+ */
+static inline void Rule_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   rules:");
+   for (i = 0; i < RULE_COUNT; i++)
+      fprintf(fp, " %s", rule_table[i].name);
+   fprintf(fp, "\n");
+}  /* Rule_list */
+
+/*-------------------------------------------------------------------
+ * Function:    Rule_panels
+ * Purpose:     Apply rule to panel_count panels of width panel_len
+ *              covering [left_endpt, right_endpt]
+ * Input args:  rule
+ *              fn
+ *              left_endpt
+ *              right_endpt
+ *              panel_count
+ *              panel_len
+ * Return val:  estimate of the integral from left_endpt to
+ *              right_endpt
+ */
+static inline double Rule_panels(
+      const quad_rule_t* rule        /* in */,
+      const integrand_t* fn          /* in */,
+      double             left_endpt  /* in */,
+      double             right_endpt /* in */,
+      long               panel_count /* in */,
+      double             panel_len   /* in */) {
+   double estimate = 0.0;
+   int k = 0, last = rule->points;
+
+   if (panel_count <= 0) return 0.0;
+   if (rule->closed) {
+      /* Endpoints, then panel boundaries (shared by two panels) */
+      estimate = rule->weight[0]*(fn->f(left_endpt) + fn->f(right_endpt));
+      estimate += 2.0*rule->weight[0]*fn->trap_sum(left_endpt, panel_len,
+            1, panel_count-1);
+      k = 1;
+      last = rule->points - 1;
+   }
+   for (; k < last; k++)
+      estimate += rule->weight[k]*fn->trap_sum(
+            left_endpt + rule->node[k]*panel_len, panel_len, 0,
+            panel_count);
+
+   return estimate*panel_len;
+}  /* Rule_panels */
+
+/*-------------------------------------------------------------------
+ * Function:    Rule_panels_repro
+ * Purpose:     Add this worker's part of the rule over n panels of
+ *              width h starting at a to acc (repro summation mode)
+ * Input args:  rule, fn, a, h, n
+ *              part:  this worker's panels;  part.first must be a
+ *                 multiple of REPRO_BLOCK, e.g.
+ *                 Partition(n, my_rank, workers, REPRO_BLOCK)
+ * In/out arg:  acc
+ * Note:        For the closed rules the worker adds the boundaries
+ *              first..first+count-1 (boundary 0 with half weight),
+ *              and the worker that has the last panel also adds
+ *              boundary n.
+ */
+static inline void Rule_panels_repro(
+      repro_t*           acc   /* in/out */,
+      const quad_rule_t* rule  /* in */,
+      const integrand_t* fn    /* in */,
+      double             a     /* in */,
+      double             h     /* in */,
+      long               n     /* in */,
+      part_t             part  /* in */) {
+   double w0;
+   int k = 0, last = rule->points;
+
+   if (part.count <= 0) return;
+   if (rule->closed) {
+      w0 = rule->weight[0]*h;
+      if (part.first == 0) {
+         Repro_add(acc, w0*fn->f(a));
+         Repro_grid_sum(acc, fn, a, h, 1, part.count - 1, 2.0*w0);
+      } else {
+         Repro_grid_sum(acc, fn, a, h, part.first, part.count, 2.0*w0);
+      }
+      if (part.first + part.count == n)
+         Repro_add(acc, w0*fn->f(a + n*h));
+      k = 1;
+      last = rule->points - 1;
+   }
+   for (; k < last; k++)
+      Repro_grid_sum(acc, fn, a + rule->node[k]*h, h, part.first,
+            part.count, rule->weight[k]*h);
+}  /* Rule_panels_repro */
+
+#endif /* _QUAD_RULES_H_ */
@@ -0,0 +1,370 @@
+/* File:     summation.h
+ *
+ * Purpose:  Summation modes for the trapezoidal rule programs, so that
+ *           a large n doesn't lose the digits it was supposed to buy:
+ *
+ *              plain     the SIMD kernel's running sums
+ *              kahan     compensated summation:  each addition's
+ *                        rounding error is computed exactly (TwoSum,
+ *                        i.e. Neumaier's variant of Kahan's method, which
+ *                        is also right when the term is larger than the
+ *                        sum) and added back at the end
+ *              pairwise  blocks of TRAP_PAIRWISE_BLOCK samples summed
+ *                        by the kernel, then added in a binary tree
+ *              repro     blocks of REPRO_BLOCK samples at fixed places
+ *                        of the global grid summed by the kernel, and
+ *                        the block sums added exactly (repro_t), so the
+ *                        result has the same bits for any number of
+ *                        threads and processes
+ *
+ *           and compensated (or exact) combining of the per-thread and
+ *           per-process results.
+ *
+ * Usage:    integrand_t fn_copy;
+ *           fn = Sum_integrand(fn, Sum_mode_find("kahan"), &fn_copy);
+ *           ... fn->trap_sum(...) now uses the compensated kernel
+ *
+ *           sum2_t total = SUM2_ZERO;
+ *        #  pragma omp parallel reduction(sum2: total)
+ *           Sum2_add(&total, Local_trap(...));
+ *           result = Sum2_value(total);
+ *
+ *           repro_t acc = REPRO_ZERO;
+ *        #  pragma omp parallel reduction(repro: acc)
+ *           Rule_panels_repro(&acc, rule, fn, a, h, n,
+ *                 Partition(n, my_rank, workers, REPRO_BLOCK));
+ *           result = Repro_value(&acc);   (or Repro_reduce with MPI)
+ *
+ * Notes:
+ *   1.  The error of the plain sum of n terms grows like n*eps, that of
+ *       the pairwise sum like log2(n)*eps, and that of the compensated
+ *       sum is about eps, independent of n.
+ *   2.  The compensated kernels do about 4 times the floating point
+ *       work of the plain ones;  for integrands that call the math
+ *       library this is hidden by the cost of f.  The pairwise mode
+ *       costs one extra call per block.
+ *   3.  A sum of doubles changes in the last bits when the terms are
+ *       grouped differently, e.g. split among another number of
+ *       threads.  The repro mode avoids both sources of this:  the
+ *       blocks summed by the kernel are fixed pieces of the global
+ *       grid (the partition must be aligned to REPRO_BLOCK, and every
+ *       sample is at x0 + i*h with the global i), and the block sums
+ *       are added into an accumulator of 32-bit integer bins covering
+ *       the whole exponent range of double, where addition is exact
+ *       and so doesn't depend on the order.  It costs one kernel
+ *       call and one Repro_add per block, so it runs at about the
+ *       speed of the plain sum;  its error is that of summing one
+ *       block, as in the pairwise mode.  Results agree bit for bit on
+ *       the same host (same SIMD kernel and math library).  Since the
+ *       work is dealt in blocks, a worker can be a block ahead of
+ *       another, and with n < workers*REPRO_BLOCK some workers get
+ *       nothing.
+ */
+#ifndef _SUMMATION_H_
+#define _SUMMATION_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "integrands.h"
+
+typedef enum {
+   SUM_PLAIN,
+   SUM_KAHAN,
+   SUM_PAIRWISE,
+   SUM_REPRO
+} sum_mode_t;
+
+static const char* const sum_mode_names[] =
+   {"plain", "kahan", "pairwise", "repro"};
+
+#define SUM_MODE_COUNT \
+   ((int) (sizeof(sum_mode_names)/sizeof(sum_mode_names[0])))
+#define SUM_MODE_DEFAULT SUM_PLAIN
+#define SUM_BAD_MODE     (-1)
+
+/*-------------------------------------------------------------------
+ * Function:    Sum_mode_find
+ * Purpose:     Look up a summation mode by name
+ * In arg:      name:  e.g. "kahan" (NULL gives SUM_MODE_DEFAULT)
+ * Return val:  the mode, or SUM_BAD_MODE if there is none with that
+ *              name
+ */
+static inline int Sum_mode_find(const char* name) {
+   int i;
+
+   if (name == NULL) return SUM_MODE_DEFAULT;
+   for (i = 0; i < SUM_MODE_COUNT; i++)
+      if (strcmp(sum_mode_names[i], name) == 0)
+         return i;
+   return SUM_BAD_MODE;
+}  /* Sum_mode_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Sum_mode_list
+ * Purpose:     Print the names of the modes (for the Usage functions)
+ */
+static inline void Sum_mode_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   summation:");
+   for (i = 0; i < SUM_MODE_COUNT; i++)
+      fprintf(fp, " %s", sum_mode_names[i]);
+   fprintf(fp, "\n");
+}  /* Sum_mode_list */
+
+/*-------------------------------------------------------------------
+ * Function:    Sum_integrand
+ * Purpose:     Get an integrand whose trap_sum uses the given mode
+ * In args:     fn, mode
+ * Out arg:     copy:  storage for the new integrand
+ * Return val:  fn itself for SUM_PLAIN and SUM_REPRO (whose blocks
+ *              are summed by the plain kernel), otherwise copy
+ */
+static inline const integrand_t* Sum_integrand(const integrand_t* fn,
+      int mode, integrand_t* copy) {
+   if (mode == SUM_PLAIN || mode == SUM_REPRO) return fn;
+   *copy = *fn;
+   copy->trap_sum = (mode == SUM_KAHAN) ? fn->trap_sum_comp
+                                        : fn->trap_sum_pairwise;
+   return copy;
+}  /* Sum_integrand */
+
+/*===================================================================
+ * Compensated combining of partial results
+ */
+typedef struct {
+   double s;   /* Running sum                  */
+   double c;   /* Rounding errors of the adds  */
+} sum2_t;
+
+#define SUM2_ZERO ((sum2_t) {0.0, 0.0})
+
+static inline void Sum2_add(sum2_t* acc, double y) {
+   double t, z;
+
+   TRAP_TWO_SUM(acc->s, acc->c, y, t, z);
+}  /* Sum2_add */
+
+static inline void Sum2_merge(sum2_t* acc, const sum2_t* other) {
+   Sum2_add(acc, other->s);
+   acc->c += other->c;
+}  /* Sum2_merge */
+
+static inline double Sum2_value(sum2_t acc) {
+   return acc.s + acc.c;
+}  /* Sum2_value */
+
+#ifdef _OPENMP
+#  pragma omp declare reduction(sum2 : sum2_t : Sum2_merge(&omp_out, &omp_in)) \
+      initializer(omp_priv = SUM2_ZERO)
+#endif
+
+/*===================================================================
+ * Exact (order independent) accumulation:  bin i holds a multiple of
+ * 2^(32*i - 1074), so each double fits in 3 bins, with room for
+ * carries in the 64-bit integers
+ */
+#define REPRO_BLOCK     65536         /* Samples per kernel call       */
+#define REPRO_BINS      66            /* 32*66 bits cover every double */
+#define REPRO_POS_INF   REPRO_BINS    /* Counts of the special values  */
+#define REPRO_NEG_INF   (REPRO_BINS + 1)
+#define REPRO_NAN       (REPRO_BINS + 2)
+#define REPRO_WORDS     (REPRO_BINS + 3)
+#define REPRO_MAX_ADDS  (1L << 29)    /* Adds between carry passes     */
+
+typedef struct {
+   long long word[REPRO_WORDS];   /* Bins, then the special counts    */
+   long      adds;                /* Adds since the last Repro_carry  */
+} repro_t;
+
+#define REPRO_ZERO ((repro_t) {{0}, 0})
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_carry
+ * Purpose:     Propagate the carries:  afterwards every bin but the
+ *              last is in [0, 2^32), so equal sums have equal bins
+ */
+static inline void Repro_carry(repro_t* acc) {
+   long long carry = 0, v;
+   int i;
+
+   for (i = 0; i < REPRO_BINS - 1; i++) {
+      v = acc->word[i] + carry;
+      carry = v >> 32;                       /* Arithmetic shift */
+      acc->word[i] = v - (carry << 32);
+   }
+   acc->word[REPRO_BINS - 1] += carry;
+   acc->adds = 1;
+}  /* Repro_carry */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_add
+ * Purpose:     Add y to the accumulator exactly
+ */
+static inline void Repro_add(repro_t* acc, double y) {
+   unsigned long long bits, m;
+   unsigned __int128 v;
+   int e, b, o;
+
+   memcpy(&bits, &y, sizeof(bits));
+   e = (int) ((bits >> 52) & 0x7ff);
+   m = bits & ((1ULL << 52) - 1);
+   if (e == 0x7ff) {
+      acc->word[m != 0 ? REPRO_NAN
+         : (bits >> 63) ? REPRO_NEG_INF : REPRO_POS_INF]++;
+      return;
+   }
+   if (e == 0) {
+      if (m == 0) return;
+      e = 1;                                 /* Subnormal */
+   } else {
+      m |= 1ULL << 52;
+   }
+
+   /* |y| = m*2^(e - 1075):  its lowest bit is bit o of bin b */
+   b = (e - 1) >> 5;
+   o = (e - 1) & 31;
+   v = (unsigned __int128) m << o;
+   if (bits >> 63) {
+      acc->word[b]   -= (long long) (v & 0xffffffffu);
+      acc->word[b+1] -= (long long) ((v >> 32) & 0xffffffffu);
+      acc->word[b+2] -= (long long) (v >> 64);
+   } else {
+      acc->word[b]   += (long long) (v & 0xffffffffu);
+      acc->word[b+1] += (long long) ((v >> 32) & 0xffffffffu);
+      acc->word[b+2] += (long long) (v >> 64);
+   }
+   if (++acc->adds >= REPRO_MAX_ADDS) Repro_carry(acc);
+}  /* Repro_add */
+
+static inline void Repro_merge(repro_t* acc, const repro_t* other) {
+   int i;
+
+   for (i = 0; i < REPRO_WORDS; i++)
+      acc->word[i] += other->word[i];
+   acc->adds += other->adds;
+   if (acc->adds >= REPRO_MAX_ADDS) Repro_carry(acc);
+}  /* Repro_merge */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_value
+ * Purpose:     Round the exact sum to a double
+ * Note:        The bins are added from the top with a compensated
+ *              sum after a carry pass, so the result depends only on
+ *              the exact sum
+ */
+static inline double Repro_value(const repro_t* acc) {
+   repro_t c = *acc;
+   double s = 0.0, err = 0.0, y, t, z;
+   int i;
+
+   if (c.word[REPRO_NAN] > 0
+         || (c.word[REPRO_POS_INF] > 0 && c.word[REPRO_NEG_INF] > 0))
+      return NAN;
+   if (c.word[REPRO_POS_INF] > 0) return INFINITY;
+   if (c.word[REPRO_NEG_INF] > 0) return -INFINITY;
+
+   Repro_carry(&c);
+   for (i = REPRO_BINS - 1; i >= 0; i--) {
+      y = ldexp((double) c.word[i], 32*i - 1074);
+      TRAP_TWO_SUM(s, err, y, t, z);
+   }
+   return s + err;
+}  /* Repro_value */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_grid_sum
+ * Purpose:     Add weight*f(x0 + i*h), i = first..first+count-1, to
+ *              acc:  the samples are cut at the multiples of
+ *              REPRO_BLOCK, each piece is summed by fn->trap_sum and
+ *              multiplied by weight, and the products are added
+ *              exactly
+ * Note:        Workers whose ranges start on multiples of REPRO_BLOCK
+ *              (with x0 and h the same for all) make the same kernel
+ *              calls, whatever the number of workers.
+ */
+static inline void Repro_grid_sum(repro_t* acc, const integrand_t* fn,
+      double x0, double h, long first, long count, double weight) {
+   long i, end, last = first + count;
+
+   for (i = first; i < last; i = end) {
+      end = (i/REPRO_BLOCK + 1)*REPRO_BLOCK;
+      if (end > last) end = last;
+      Repro_add(acc, weight*fn->trap_sum(x0, h, i, end - i));
+   }
+}  /* Repro_grid_sum */
+
+#ifdef _OPENMP
+#  pragma omp declare reduction(repro : repro_t : Repro_merge(&omp_out, &omp_in)) \
+      initializer(omp_priv = REPRO_ZERO)
+#endif
+
+#ifdef MPI_VERSION
+static void Sum2_mpi_op(void* in, void* inout, int* len,
+      MPI_Datatype* type) {
+   sum2_t* a = (sum2_t*) in;
+   sum2_t* b = (sum2_t*) inout;
+   int i;
+
+   (void) type;
+   for (i = 0; i < *len; i++)
+      Sum2_merge(&b[i], &a[i]);
+}  /* Sum2_mpi_op */
+
+/*-------------------------------------------------------------------
+ * Function:    Sum2_mpi_create
+ * Purpose:     Build the datatype and operation to reduce sum2_t
+ *              values (e.g. with MPI_Ireduce);  free them with
+ *              MPI_Type_free and MPI_Op_free
+ */
+static inline void Sum2_mpi_create(MPI_Datatype* sum2_mpi_t_p,
+      MPI_Op* sum2_op_p) {
+   MPI_Type_contiguous(2, MPI_DOUBLE, sum2_mpi_t_p);
+   MPI_Type_commit(sum2_mpi_t_p);
+   MPI_Op_create(Sum2_mpi_op, 1, sum2_op_p);
+}  /* Sum2_mpi_create */
+
+/*-------------------------------------------------------------------
+ * Function:    Sum2_reduce
+ * Purpose:     Compensated MPI_Reduce of one double per process
+ * In args:     local, root, comm
+ * Return val:  the total on root (undefined elsewhere)
+ */
+static inline double Sum2_reduce(double local, int root, MPI_Comm comm) {
+   MPI_Datatype sum2_mpi_t;
+   MPI_Op sum2_op;
+   sum2_t mine = {local, 0.0}, total = SUM2_ZERO;
+
+   Sum2_mpi_create(&sum2_mpi_t, &sum2_op);
+   MPI_Reduce(&mine, &total, 1, sum2_mpi_t, sum2_op, root, comm);
+   MPI_Op_free(&sum2_op);
+   MPI_Type_free(&sum2_mpi_t);
+
+   return Sum2_value(total);
+}  /* Sum2_reduce */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_reduce
+ * Purpose:     Exact MPI_Reduce of one repro_t per process
+ * In args:     local, root, comm
+ * Return val:  the total, rounded, on root (undefined elsewhere)
+ * Note:        After a carry pass each bin is below 2^32, so the
+ *              integer MPI_SUM can't overflow, and integer addition
+ *              gives the same bins in any order.
+ */
+static inline double Repro_reduce(const repro_t* local, int root,
+      MPI_Comm comm) {
+   repro_t mine = *local, total = REPRO_ZERO;
+   int comm_sz;
+
+   Repro_carry(&mine);
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Reduce(mine.word, total.word, REPRO_WORDS, MPI_LONG_LONG, MPI_SUM,
+         root, comm);
+   total.adds = comm_sz;
+
+   return Repro_value(&total);
+}  /* Repro_reduce */
+#endif
+
+#endif /* _SUMMATION_H_ */
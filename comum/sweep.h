@@ -0,0 +1,184 @@
+/* File:     sweep.h
+ *
+ * Purpose:  Integrals of a family of functions f(x; t) over the same
+ *           [a, b] for many values of the parameter t, in the style of
+ *           cubature.h:  the family is chosen at run time by name, and
+ *           each one has its own kernel with the formula inlined.
+ *
+ *              const sweep_integrand_t* fn = Sweep_find("gauss");
+ *              Sweep_tile(fn, rule, a, h, n, theta, count, result);
+ *
+ *           gives result[j] = the integral of f(x; theta[j]) for
+ *           j < count <= SWEEP_THETA_TILE.  The grid is walked in tiles
+ *           of SWEEP_X_TILE nodes:  the nodes and weights of a tile are
+ *           computed once and stay in the L1 cache while the kernel
+ *           sums them for every t of the tile of parameters, instead of
+ *           the whole grid being set up and streamed once per t.
+ *
+ * Adding a family:
+ *    1.  #define F2_<name>(x, t) with its formula
+ *    2.  SWEEP_DEFINE(<name>), and its exact integral if known
+ *    3.  Add a line to sweep_table
+ *
+ * Notes:
+ *   1.  The rules (trap or simpson) and their nodes and weights are
+ *       those of cubature.h.
+ *   2.  The kernels keep SWEEP_LANES independent sums and are compiled
+ *       for AVX-512, AVX2 and plain x86-64, as the row kernels of
+ *       cubature.h are.
+ *   3.  The tile sums of each t are added with a compensated sum
+ *       (comum/summation.h).
+ */
+#ifndef _SWEEP_H_
+#define _SWEEP_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "summation.h"
+#include "cubature.h"
+
+#define SWEEP_LANES       8
+#define SWEEP_X_TILE      512   /* Nodes per tile:  8 KB of nodes and weights */
+#define SWEEP_THETA_TILE  16    /* Parameters per tile                         */
+
+typedef double (*sweep_row_t)(const double x[], const double w[], long count,
+      double t);
+
+typedef struct {
+   const char* name;
+   const char* formula;
+   sweep_row_t row_sum;    /* sum of w[i]*f(x[i]; t), i < count      */
+   double (*exact)(double a, double b, double t);
+                           /* NULL if not known, NAN for a bad t     */
+} sweep_integrand_t;
+
+#define SWEEP_DEFINE(name)                                              \
+__attribute__ ((target_clones ("avx512f", "avx2", "default")))          \
+static double Sweep_row_##name(const double x[], const double w[],      \
+      long count, double t) {                                           \
+   double acc[SWEEP_LANES] = {0.0}, sum = 0.0;                          \
+   long i;                                                              \
+   int k;                                                               \
+                                                                        \
+   for (i = 0; i + SWEEP_LANES <= count; i += SWEEP_LANES)              \
+      for (k = 0; k < SWEEP_LANES; k++)                                 \
+         acc[k] += w[i+k]*F2_##name(x[i+k], t);                         \
+   for (; i < count; i++)                                               \
+      sum += w[i]*F2_##name(x[i], t);                                   \
+   for (k = 0; k < SWEEP_LANES; k++)                                    \
+      sum += acc[k];                                                    \
+   return sum;                                                          \
+}
+
+/*--------------------------------------------------------------------
+ * Families
+ */
+#define F2_gauss(x, t)  exp(-(t)*(x)*(x))
+SWEEP_DEFINE(gauss)
+
+static double Sweep_exact_gauss(double a, double b, double t) {
+   double r;
+
+   if (t == 0.0) return b - a;
+   if (t < 0.0) return NAN;
+   r = sqrt(t);
+   return sqrt(M_PI)/(2.0*r)*(erf(r*b) - erf(r*a));
+}  /* Sweep_exact_gauss */
+
+#define F2_cos(x, t)  cos((t)*(x))
+SWEEP_DEFINE(cos)
+
+static double Sweep_exact_cos(double a, double b, double t) {
+   if (t == 0.0) return b - a;
+   return (sin(t*b) - sin(t*a))/t;
+}  /* Sweep_exact_cos */
+
+#define F2_decay(x, t)  exp(-(t)*(x))
+SWEEP_DEFINE(decay)
+
+static double Sweep_exact_decay(double a, double b, double t) {
+   if (t == 0.0) return b - a;
+   return (exp(-t*a) - exp(-t*b))/t;
+}  /* Sweep_exact_decay */
+
+#define F2_lorentz(x, t)  (1.0/(1.0 + (t)*(x)*(x)))
+SWEEP_DEFINE(lorentz)
+
+static double Sweep_exact_lorentz(double a, double b, double t) {
+   double r;
+
+   if (t == 0.0) return b - a;
+   if (t < 0.0) return NAN;
+   r = sqrt(t);
+   return (atan(r*b) - atan(r*a))/r;
+}  /* Sweep_exact_lorentz */
+
+static const sweep_integrand_t sweep_table[] = {
+   {"gauss",   "exp(-t x^2)",    Sweep_row_gauss,   Sweep_exact_gauss},
+   {"cos",     "cos(t x)",       Sweep_row_cos,     Sweep_exact_cos},
+   {"decay",   "exp(-t x)",      Sweep_row_decay,   Sweep_exact_decay},
+   {"lorentz", "1/(1 + t x^2)",  Sweep_row_lorentz, Sweep_exact_lorentz},
+};
+
+#define SWEEP_COUNT ((int) (sizeof(sweep_table)/sizeof(sweep_table[0])))
+#define SWEEP_DEFAULT "gauss"
+
+/*-------------------------------------------------------------------
+ * Function:    Sweep_find
+ * Purpose:     Look up a family by name
+ * In arg:      name:  e.g. "gauss" (NULL gives SWEEP_DEFAULT)
+ * Return val:  pointer into sweep_table, or NULL if there is no
+ *              family with that name
+ */
+static inline const sweep_integrand_t* Sweep_find(const char* name) {
+   int i;
+
+   if (name == NULL) name = SWEEP_DEFAULT;
+   for (i = 0; i < SWEEP_COUNT; i++)
+      if (strcmp(sweep_table[i].name, name) == 0)
+         return &sweep_table[i];
+   return NULL;
+}  /* Sweep_find */
+
+/*-------------------------------------------------------------------
+ * Function:    Sweep_list
+ * Purpose:     Print the families and rules (for the Usage functions)
+ */
+static inline void Sweep_list(FILE* fp) {
+   int i;
+
+   fprintf(fp, "   families:\n");
+   for (i = 0; i < SWEEP_COUNT; i++)
+      fprintf(fp, "      %-8s %s\n", sweep_table[i].name,
+            sweep_table[i].formula);
+   fprintf(fp, "   rules: trap simpson\n");
+}  /* Sweep_list */
+
+/*-------------------------------------------------------------------
+ * Function:    Sweep_tile
+ * Purpose:     Integrate f(x; theta[j]) over n panels of width h
+ *              starting at a, for j < count (count <= SWEEP_THETA_TILE)
+ * Out arg:     result:  count integrals
+ */
+static inline void Sweep_tile(const sweep_integrand_t* fn, int rule,
+      double a, double h, long n, const double theta[], int count,
+      double result[]) {
+   double node[SWEEP_X_TILE], weight[SWEEP_X_TILE];
+   sum2_t total[SWEEP_THETA_TILE];
+   long points = Cube_points(rule, n), t, len;
+   int j;
+
+   for (j = 0; j < count; j++)
+      total[j] = SUM2_ZERO;
+   for (t = 0; t < points; t += SWEEP_X_TILE) {
+      len = (points - t < SWEEP_X_TILE) ? points - t : SWEEP_X_TILE;
+      Cube_nodes(rule, a, h, n, t, len, node, weight);
+      for (j = 0; j < count; j++)
+         Sum2_add(&total[j], fn->row_sum(node, weight, len, theta[j]));
+   }
+   for (j = 0; j < count; j++)
+      result[j] = Sum2_value(total[j]);
+}  /* Sweep_tile */
+
+#endif /* _SWEEP_H_ */
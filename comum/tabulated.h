@@ -0,0 +1,154 @@
+/* File:     tabulated.h
+ *
+ * Purpose:  Trapezoidal rule for tabulated samples (x_i, y_i), e.g.
+ *           measurements, read straight from a memory-mapped binary
+ *           file:
+ *
+ *              integral = sum of (x_{i+1} - x_i)*(y_i + y_{i+1})/2
+ *
+ *           over the intervals i = 0..samples-2, so the x_i don't have
+ *           to be evenly spaced.
+ *
+ *           The file holds samples pairs of doubles x_0 y_0 x_1 y_1 ...
+ *           in the byte order of the machine, with no header.  A worker
+ *           gets a block of the intervals, say first..first+count-1,
+ *           and maps only the samples it needs:  first..first+count,
+ *           i.e. its block plus the one sample at its right boundary,
+ *           which is also the first sample of the next worker.
+ *
+ * Usage:    fd = Tab_open(path, &samples);
+ *           part = Partition(samples - 1, my_rank, workers, TAB_ALIGN);
+ *           sum = Tab_trap(fd, part.first, part.count, &stats);
+ *
+ * Notes:
+ *   1.  The mapping is read sequentially, one window of TAB_WINDOW
+ *       bytes at a time;  each window is dropped from the process
+ *       (madvise MADV_DONTNEED) when it's done, so a file of any size
+ *       takes at most about one window of memory per worker, plus
+ *       what the kernel keeps in its page cache.
+ *   2.  The window sums are added with a compensated sum
+ *       (comum/summation.h).
+ *   3.  Intervals where x decreases are integrated as they are (with
+ *       a negative width) and counted, so a file that isn't sorted by
+ *       x can be spotted.
+ *   4.  With align = TAB_ALIGN the blocks start on page boundaries of
+ *       the file.
+ */
+#ifndef _TABULATED_H_
+#define _TABULATED_H_
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "summation.h"
+
+#define TAB_SAMPLE_BYTES  (2*sizeof(double))
+#define TAB_ALIGN         256           /* Samples in a 4 KB page */
+#define TAB_WINDOW        (1L << 26)    /* 64 MB                  */
+
+typedef struct {
+   long   intervals;   /* Intervals integrated   */
+   long   decreasing;  /* Of which with x_{i+1} < x_i */
+} tab_stats_t;
+
+/*-------------------------------------------------------------------
+ * Function:    Tab_open
+ * Purpose:     Open a file of samples for reading
+ * Out arg:     samples_p:  number of (x, y) pairs in the file
+ * Return val:  the file descriptor, or -1 if the file can't be read
+ *              or its size isn't a multiple of TAB_SAMPLE_BYTES
+ */
+static inline int Tab_open(const char* path, long* samples_p) {
+   struct stat st;
+   int fd;
+
+   *samples_p = 0;
+   if ((fd = open(path, O_RDONLY)) < 0) return -1;
+   if (fstat(fd, &st) < 0 || st.st_size % TAB_SAMPLE_BYTES != 0) {
+      close(fd);
+      return -1;
+   }
+   *samples_p = st.st_size/TAB_SAMPLE_BYTES;
+   return fd;
+}  /* Tab_open */
+
+/*-------------------------------------------------------------------
+ * Function:    Tab_trap_sum
+ * Purpose:     Trapezoidal rule over the count intervals of the
+ *              count+1 samples at xy (x and y interleaved)
+ * In/out arg:  decreasing:  incremented for each interval with
+ *              x_{i+1} < x_i
+ * Note:        Four independent sums, as in the scalar kernel of
+ *              trap_simd.h
+ */
+static inline double Tab_trap_sum(const double* xy, long count,
+      long* decreasing) {
+   double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0, dx;
+   long i, down = 0;
+
+#  define TAB_TERM(s, j) \
+      dx = xy[2*(j)+2] - xy[2*(j)]; \
+      down += dx < 0.0; \
+      s += dx*(xy[2*(j)+1] + xy[2*(j)+3]);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+      TAB_TERM(s0, i);
+      TAB_TERM(s1, i+1);
+      TAB_TERM(s2, i+2);
+      TAB_TERM(s3, i+3);
+   }
+   for (; i < count; i++) {
+      TAB_TERM(s0, i);
+   }
+#  undef TAB_TERM
+
+   *decreasing += down;
+   return ((s0 + s1) + (s2 + s3))/2.0;
+}  /* Tab_trap_sum */
+
+/*-------------------------------------------------------------------
+ * Function:    Tab_trap
+ * Purpose:     Trapezoidal rule over the intervals first..first+count-1
+ *              of the file, mapping samples first..first+count
+ * In/out arg:  stats:  intervals and decreasing are incremented
+ * Return val:  the estimate, or NAN if the samples can't be mapped
+ */
+static inline double Tab_trap(int fd, long first, long count,
+      tab_stats_t* stats) {
+   long page = sysconf(_SC_PAGESIZE);
+   off_t start = first*TAB_SAMPLE_BYTES, offset;
+   size_t length, done, keep, dropped = 0;
+   const char* map;
+   const double* xy;
+   sum2_t total = SUM2_ZERO;
+   long i, len, per_window = TAB_WINDOW/TAB_SAMPLE_BYTES;
+
+   if (count <= 0) return 0.0;
+   offset = start - start % page;
+   length = (start - offset) + (count + 1)*TAB_SAMPLE_BYTES;
+   map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, offset);
+   if (map == MAP_FAILED) return NAN;
+   madvise((void*) map, length, MADV_SEQUENTIAL);
+   xy = (const double*) (map + (start - offset));
+
+   for (i = 0; i < count; i += len) {
+      len = (count - i < per_window) ? count - i : per_window;
+      Sum2_add(&total, Tab_trap_sum(xy + 2*i, len, &stats->decreasing));
+
+      /* Drop the whole pages before the next window's first sample */
+      done = (start - offset) + (i + len)*TAB_SAMPLE_BYTES;
+      keep = done - done % page;
+      if (keep > dropped) {
+         madvise((void*) (map + dropped), keep - dropped, MADV_DONTNEED);
+         dropped = keep;
+      }
+   }
+   stats->intervals += count;
+
+   munmap((void*) map, length);
+   return Sum2_value(total);
+}  /* Tab_trap */
+
+#endif /* _TABULATED_H_ */
@@ -0,0 +1,265 @@
+/* File:     trap_cache.h
+ *
+ * Purpose:  On-disk cache of trapezoidal rule sums, so repeated
+ *           integrals cost a file read, and finer ones only cost the
+ *           new samples.
+ *
+ *           Write n = n_odd*2^L with n_odd odd.  All the trapezoidal
+ *           estimates of f on [a, b] with n_odd*2^l trapezoids,
+ *           l = 0, 1, 2, ..., share one cache entry, whose name is a
+ *           hash of (formula of f, summation mode, a, b, n_odd).  The
+ *           entry keeps
+ *
+ *              level        finest l computed so far
+ *              level_sum[l] sum of f at the samples 0..n-1 of level l
+ *              part_sum[k]  the same sum at the finest level, split
+ *                           into parts (blocks of the n_odd cells)
+ *
+ *           A query with l <= level is answered from level_sum.  For
+ *           l > level, level+1, ..., l are added one at a time:  the
+ *           new samples of a level are the midpoints of the cells of
+ *           the level before.  Each worker (thread or process) sums
+ *           (by fn->trap_sum) its block of the Cache_new_samples of
+ *           the level, split at the boundaries of the parts, and the
+ *           workers' sums of each part are added to its part_sum.
+ *
+ * Usage:    trap_cache_t cache;
+ *           Cache_load(dir, fn, mode, a, b, n, &cache);
+ *           for (level = cache.level+1; level <= Cache_level(n); level++) {
+ *              part_sum[k] = 0 for every k;
+ *              (in parallel, part_sum[] reduced with +)
+ *              mine = Partition(Cache_new_samples(&cache, level),
+ *                    my_rank, workers, PART_ALIGN);
+ *              Cache_range_sums(&cache, fn, level, mine.first,
+ *                    mine.count, part_sum);
+ *              Cache_add_level(&cache, fn, level, part_sum);
+ *           }
+ *           Cache_save(dir, &cache);
+ *           estimate = Cache_estimate(&cache, fn, n);
+ *
+ * Notes:
+ *   1.  The files are binary images of trap_cache_t, so they are
+ *       only read back on machines with the same layout.  An entry
+ *       whose key doesn't match (hash collision, other version) is
+ *       ignored and overwritten.
+ *   2.  Files are written to a temporary name and renamed, so a
+ *       reader never sees half an entry.
+ *   3.  The midpoints of level l are computed as (a + h_l) + j*2h_l,
+ *       so a refined estimate can differ from a direct one in the
+ *       last bits.  The work of a level is split by samples, not by
+ *       parts, so every worker has work even when n_odd is small
+ *       (n = 2^L gives a single part);  the price is that the sums
+ *       can differ in the last bits with the number of workers.
+ *   4.  The parts are only the unit of storage:  CACHE_PARTS of them
+ *       (fewer if n_odd is smaller), whatever the number of workers.
+ */
+#ifndef _TRAP_CACHE_H_
+#define _TRAP_CACHE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "integrands.h"
+#include "partition.h"
+
+#define CACHE_MAGIC     0x54524150434132ULL   /* "TRAPCA2" */
+#define CACHE_PARTS     64
+#define CACHE_LEVELS    64
+#define CACHE_FORMULA   256
+#define CACHE_PATH      1024
+
+typedef struct {
+   unsigned long long magic;
+   char   formula[CACHE_FORMULA];
+   int    mode;        /* Summation mode of the sums             */
+   double a, b;
+   long   n_odd;
+   int    level;       /* -1 if nothing is computed yet          */
+   int    parts;
+   double f_b;         /* f(b), the only sample not in a part    */
+   double level_sum[CACHE_LEVELS];
+   double part_sum[CACHE_PARTS];
+} trap_cache_t;
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_level
+ * Purpose:     Number of times n can be halved (L in n = n_odd*2^L)
+ */
+static inline int Cache_level(long n) {
+   return __builtin_ctzl((unsigned long) n);
+}  /* Cache_level */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_hash
+ * Purpose:     64-bit FNV-1a hash of the key of an entry
+ */
+static inline unsigned long long Cache_hash(const char* formula,
+      int mode, double a, double b, long n_odd) {
+   unsigned long long hash = 14695981039346656037ULL;
+   const unsigned char* p;
+   size_t i;
+
+   for (p = (const unsigned char*) formula; *p != '\0'; p++)
+      hash = (hash ^ *p)*1099511628211ULL;
+   for (i = 0, p = (const unsigned char*) &mode; i < sizeof(mode); i++)
+      hash = (hash ^ p[i])*1099511628211ULL;
+   for (i = 0, p = (const unsigned char*) &a; i < sizeof(a); i++)
+      hash = (hash ^ p[i])*1099511628211ULL;
+   for (i = 0, p = (const unsigned char*) &b; i < sizeof(b); i++)
+      hash = (hash ^ p[i])*1099511628211ULL;
+   for (i = 0, p = (const unsigned char*) &n_odd; i < sizeof(n_odd); i++)
+      hash = (hash ^ p[i])*1099511628211ULL;
+   return hash;
+}  /* Cache_hash */
+
+static inline void Cache_path(const char* dir, const trap_cache_t* cache,
+      char path[]) {
+   snprintf(path, CACHE_PATH, "%s/%016llx.trap", dir,
+         Cache_hash(cache->formula, cache->mode, cache->a, cache->b,
+            cache->n_odd));
+}  /* Cache_path */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_load
+ * Purpose:     Read the entry for (fn, mode, a, b, n), or start an empty
+ *              one
+ * In args:     dir, fn, a, b, n
+ *              mode:  summation mode of fn->trap_sum (comum/summation.h)
+ * Out arg:     cache
+ * Return val:  1 if the entry was found, 0 otherwise
+ */
+static inline int Cache_load(const char* dir, const integrand_t* fn,
+      int mode, double a, double b, long n, trap_cache_t* cache) {
+   trap_cache_t stored;
+   char path[CACHE_PATH];
+   FILE* fp;
+   int found = 0;
+
+   memset(cache, 0, sizeof(trap_cache_t));
+   cache->magic = CACHE_MAGIC;
+   strncpy(cache->formula, fn->formula, CACHE_FORMULA - 1);
+   cache->mode = mode;
+   cache->a = a;
+   cache->b = b;
+   cache->n_odd = n >> Cache_level(n);
+   cache->level = -1;
+   cache->parts = cache->n_odd < CACHE_PARTS
+      ? (int) cache->n_odd : CACHE_PARTS;
+
+   Cache_path(dir, cache, path);
+   if ((fp = fopen(path, "rb")) != NULL) {
+      if (fread(&stored, sizeof(stored), 1, fp) == 1
+            && stored.magic == CACHE_MAGIC
+            && strcmp(stored.formula, cache->formula) == 0
+            && stored.mode == mode
+            && stored.a == a && stored.b == b
+            && stored.n_odd == cache->n_odd
+            && stored.parts == cache->parts) {
+         *cache = stored;
+         found = 1;
+      }
+      fclose(fp);
+   }
+   return found;
+}  /* Cache_load */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_save
+ * Purpose:     Write the entry (atomically) to dir
+ * Return val:  1 on success, 0 otherwise
+ */
+static inline int Cache_save(const char* dir, const trap_cache_t* cache) {
+   char path[CACHE_PATH], tmp[CACHE_PATH + 16];
+   FILE* fp;
+   int ok;
+
+   Cache_path(dir, cache, path);
+   snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+   if ((fp = fopen(tmp, "wb")) == NULL) return 0;
+   ok = fwrite(cache, sizeof(trap_cache_t), 1, fp) == 1;
+   ok = (fclose(fp) == 0) && ok;
+   if (ok) ok = rename(tmp, path) == 0;
+   if (!ok) remove(tmp);
+   return ok;
+}  /* Cache_save */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_new_samples
+ * Purpose:     Number of samples that are new at level (at level 0,
+ *              all the samples but b)
+ */
+static inline long Cache_new_samples(const trap_cache_t* cache,
+      int level) {
+   return level == 0 ? cache->n_odd : cache->n_odd << (level-1);
+}  /* Cache_new_samples */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_range_sums
+ * Purpose:     Add the sums of f at the new samples first..first+count-1
+ *              of level to the parts they belong to
+ * In args:     cache, fn, level, first, count
+ * In/out arg:  sum:  sum[k] += the sum of the samples in part k, for
+ *              k < cache->parts
+ */
+static inline void Cache_range_sums(const trap_cache_t* cache,
+      const integrand_t* fn, int level, long first, long count,
+      double sum[]) {
+   double h = (cache->b - cache->a)/cache->n_odd, x0;
+   long lo, hi;
+   int k, shift = level == 0 ? 0 : level-1;
+   part_t part;
+
+   if (level == 0) {
+      x0 = cache->a;
+   } else {
+      h = ldexp(h, -level);
+      x0 = cache->a + h;
+      h = 2.0*h;
+   }
+   for (k = 0; k < cache->parts; k++) {
+      /* Part k's new samples are a block of the level's */
+      part = Partition(cache->n_odd, k, cache->parts, 1);
+      lo = part.first << shift;
+      hi = (part.first + part.count) << shift;
+      if (lo < first) lo = first;
+      if (hi > first + count) hi = first + count;
+      if (lo < hi) sum[k] += fn->trap_sum(x0, h, lo, hi - lo);
+   }
+}  /* Cache_range_sums */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_add_level
+ * Purpose:     Add the sums of the new samples of level (which must
+ *              be cache->level + 1) to the entry
+ * In args:     level
+ *              new_sum:  new_sum[k] = sum of f at the new samples of
+ *                 part k (see Cache_range_sums)
+ * In/out arg:  cache
+ */
+static inline void Cache_add_level(trap_cache_t* cache,
+      const integrand_t* fn, int level, const double new_sum[]) {
+   double total = 0.0;
+   int k;
+
+   if (level == 0) cache->f_b = fn->f(cache->b);
+   for (k = 0; k < cache->parts; k++) {
+      cache->part_sum[k] += new_sum[k];
+      total += cache->part_sum[k];
+   }
+   cache->level_sum[level] = total;
+   cache->level = level;
+}  /* Cache_add_level */
+
+/*-------------------------------------------------------------------
+ * Function:    Cache_estimate
+ * Purpose:     Trapezoidal estimate with n trapezoids, from an entry
+ *              with cache->level >= Cache_level(n)
+ */
+static inline double Cache_estimate(const trap_cache_t* cache,
+      const integrand_t* fn, long n) {
+   double h = (cache->b - cache->a)/n;
+   double f_a = fn->f(cache->a);
+
+   return h*(cache->level_sum[Cache_level(n)] - f_a/2.0 + cache->f_b/2.0);
+}  /* Cache_estimate */
+
+#endif /* _TRAP_CACHE_H_ */
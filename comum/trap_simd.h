@@ -0,0 +1,441 @@
+/* File:     trap_simd.h
+ *
+ * Purpose:  Vectorized kernel for the sum in the trapezoidal rule,
+ *
+ *              Trap_sum(x0, h, first, count) =
+ *                 f(x0 + first*h) + ... + f(x0 + (first+count-1)*h)
+ *
+ *           with AVX-512, AVX2 and scalar versions.  The version is
+ *           chosen at run time from the CPU we are running on, so the
+ *           same executable works on every host.
+ *
+ * Usage:    The header is a "template":  define the integrand and a
+ *           name, then include it.  Each inclusion defines a new
+ *           kernel Trap_sum_<name>, and two variants with the same
+ *           arguments that lose less precision when count is huge:
+ *
+ *              Trap_sum_<name>_comp      compensated (TwoSum) sum
+ *              Trap_sum_<name>_pairwise  pairwise sum of blocks
+ *
+ *              #define TRAP_SIMD_F(x)  ((x)*(x))
+ *              #define TRAP_SIMD_NAME  quad
+ *              #include "../../comum/trap_simd.h"
+ *              . . .
+ *              sum = Trap_sum_quad(a, h, 1, n-1);
+ *
+ *           TRAP_SIMD_F may only use + - * / and parentheses, since
+ *           it is also applied to whole vectors.  If it calls a math
+ *           library function (exp, sin, ...), also define
+ *           TRAP_SIMD_LANEWISE:  the x values are still generated and
+ *           summed in vectors, but f is applied one lane at a time.
+ *
+ * Notes:
+ *   1.  Each kernel keeps several independent vector accumulators,
+ *       so consecutive additions don't wait on each other.
+ *   2.  x is always computed as x0 + i*h (never by adding h over and
+ *       over), so the sample points are the same ones the scalar
+ *       loop in Trap uses.  The product i*h is rounded before x0 is
+ *       added (TRAP_SIMD_X):  in the kernels compiled with FMA the
+ *       compiler would otherwise be free to fuse the two, and the
+ *       points could differ in the last bit from the scalar ones.
+ *   3.  Setting the environment variable TRAP_SIMD to "avx512",
+ *       "avx2" or "scalar" forces a version (e.g. for timing).
+ *   4.  Needs gcc or clang (vector extensions, target attribute and
+ *       __builtin_cpu_supports) on x86-64.
+ */
+
+/*-------------------------------------------------------------------
+ * Part included only once:  vector types and the ISA selection
+ */
+#ifndef _TRAP_SIMD_H_
+#define _TRAP_SIMD_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef double trap_v4d __attribute__ ((vector_size (32)));
+typedef double trap_v8d __attribute__ ((vector_size (64)));
+
+typedef enum {TRAP_ISA_SCALAR, TRAP_ISA_AVX2, TRAP_ISA_AVX512} trap_isa_t;
+
+#define TRAP_SIMD_CAT_(a, b) a ## b
+#define TRAP_SIMD_CAT(a, b)  TRAP_SIMD_CAT_(a, b)
+
+/* Samples summed directly by the kernel:  spread over its 32 SIMD
+ * accumulators, each adds only ~2048 of them, and the block is large
+ * enough that the call and lane reduction per block don't show */
+#define TRAP_PAIRWISE_BLOCK 65536
+
+typedef double (*trap_sum_t)(double x0, double h, long first, long count);
+
+/* x0 + i*h (i a double or a vector of them), with the product
+ * rounded first:  the empty asm hides it from the optimizer, so it
+ * can't be fused with the add into an FMA (see note 2) */
+#define TRAP_SIMD_X(x0, i, h) ({ \
+   __typeof__ ((i)*(h)) trap_p_ = (i)*(h); \
+   __asm__ ("" : "+v" (trap_p_)); \
+   (x0) + trap_p_; \
+})
+
+/* Knuth's TwoSum:  s + y is exactly (new s) + (rounding error), and
+ * the error is added to c.  Works for scalars and vectors. */
+#define TRAP_TWO_SUM(s, c, y, t, z) { \
+   t = (s) + (y); \
+   z = t - (s); \
+   c += ((s) - (t - z)) + ((y) - z); \
+   s = t; \
+}
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_pairwise
+ * Purpose:     Sum f(x0 + i*h), i = first..first+count-1, by splitting
+ *              the range in halves until it has at most
+ *              TRAP_PAIRWISE_BLOCK samples, and summing those with
+ *              sum.  The rounding error grows with log(count) instead
+ *              of count.
+ */
+static inline double Trap_sum_pairwise(trap_sum_t sum, double x0,
+      double h, long first, long count) {
+   long half;
+
+   if (count <= TRAP_PAIRWISE_BLOCK) return sum(x0, h, first, count);
+   half = (count/2 + 31) & ~31L;   /* Keep the blocks SIMD friendly */
+   return Trap_sum_pairwise(sum, x0, h, first, half)
+      + Trap_sum_pairwise(sum, x0, h, first + half, count - half);
+}  /* Trap_sum_pairwise */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_simd_isa
+ * Purpose:     Find the widest instruction set the CPU supports (or
+ *              the one asked for in the TRAP_SIMD environment
+ *              variable)
+ * Return val:  TRAP_ISA_AVX512, TRAP_ISA_AVX2 or TRAP_ISA_SCALAR
+ * Note:        The kernels call this once per chunk, so the choice is
+ *              made on the first call and kept.  Threads that make
+ *              the first calls at the same time all find the same
+ *              answer;  the atomics only keep the stores from being a
+ *              data race.
+ */
+static inline trap_isa_t Trap_simd_isa(void) {
+   static int chosen = -1;
+   const char* forced;
+   int avx2, isa = __atomic_load_n(&chosen, __ATOMIC_RELAXED);
+
+   if (isa >= 0) return (trap_isa_t) isa;
+
+   __builtin_cpu_init();
+   forced = getenv("TRAP_SIMD");
+   /* The AVX2 kernel is compiled with target("avx2,fma") */
+   avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+   if (forced != NULL && strcmp(forced, "scalar") == 0)
+      isa = TRAP_ISA_SCALAR;
+   else if (forced != NULL && strcmp(forced, "avx2") == 0 && avx2)
+      isa = TRAP_ISA_AVX2;
+   else if ((forced == NULL || strcmp(forced, "avx512") == 0)
+         && __builtin_cpu_supports("avx512f"))
+      isa = TRAP_ISA_AVX512;
+   else if (avx2)
+      isa = TRAP_ISA_AVX2;
+   else
+      isa = TRAP_ISA_SCALAR;
+
+   __atomic_store_n(&chosen, isa, __ATOMIC_RELAXED);
+   return (trap_isa_t) isa;
+}  /* Trap_simd_isa */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_simd_isa_name
+ * Purpose:     Name of the version Trap_sum_<name> will use, for
+ *              printing
+ */
+static inline const char* Trap_simd_isa_name(void) {
+   switch (Trap_simd_isa()) {
+      case TRAP_ISA_AVX512: return "avx512";
+      case TRAP_ISA_AVX2:   return "avx2";
+      default:              return "scalar";
+   }
+}  /* Trap_simd_isa_name */
+
+#endif /* _TRAP_SIMD_H_ */
+
+/*-------------------------------------------------------------------
+ * Part included once per integrand:  the kernels themselves
+ */
+#if !defined(TRAP_SIMD_F) || !defined(TRAP_SIMD_NAME)
+#error "define TRAP_SIMD_F(x) and TRAP_SIMD_NAME before including trap_simd.h"
+#endif
+
+#define TRAP_SIMD_FN(suffix) \
+   TRAP_SIMD_CAT(TRAP_SIMD_CAT(Trap_sum_, TRAP_SIMD_NAME), suffix)
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_f4, Trap_sum_<name>_f8
+ * Purpose:     Apply f to every lane of a vector
+ */
+__attribute__ ((target ("avx2,fma")))
+static inline trap_v4d TRAP_SIMD_FN(_f4)(trap_v4d x) {
+#ifdef TRAP_SIMD_LANEWISE
+   trap_v4d y;
+   int k;
+
+   for (k = 0; k < 4; k++)
+      y[k] = TRAP_SIMD_F(x[k]);
+   return y;
+#else
+   return TRAP_SIMD_F(x);
+#endif
+}  /* Trap_sum_<name>_f4 */
+
+__attribute__ ((target ("avx512f")))
+static inline trap_v8d TRAP_SIMD_FN(_f8)(trap_v8d x) {
+#ifdef TRAP_SIMD_LANEWISE
+   trap_v8d y;
+   int k;
+
+   for (k = 0; k < 8; k++)
+      y[k] = TRAP_SIMD_F(x[k]);
+   return y;
+#else
+   return TRAP_SIMD_F(x);
+#endif
+}  /* Trap_sum_<name>_f8 */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_scalar
+ * Purpose:     Portable version:  four independent accumulators
+ */
+static double TRAP_SIMD_FN(_scalar)(double x0, double h, long first,
+      long count) {
+   double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+   long i, last = first + count;
+
+   for (i = first; i + 4 <= last; i += 4) {
+      s0 += TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) i, h));
+      s1 += TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) (i+1), h));
+      s2 += TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) (i+2), h));
+      s3 += TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) (i+3), h));
+   }
+   for (; i < last; i++)
+      s0 += TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) i, h));
+
+   return (s0 + s1) + (s2 + s3);
+}  /* Trap_sum_<name>_scalar */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_avx2
+ * Purpose:     4 doubles per vector, 4 vector accumulators (16
+ *              samples per iteration)
+ */
+__attribute__ ((target ("avx2,fma")))
+static double TRAP_SIMD_FN(_avx2)(double x0, double h, long first,
+      long count) {
+   const trap_v4d lane = {0.0, 1.0, 2.0, 3.0};
+   trap_v4d acc0 = {0.0}, acc1 = {0.0}, acc2 = {0.0}, acc3 = {0.0};
+   trap_v4d idx, x;
+   long i, last = first + count;
+   double sum;
+
+   idx = lane + (double) first;
+   for (i = first; i + 16 <= last; i += 16) {
+      x = TRAP_SIMD_X(x0, idx, h);          acc0 += TRAP_SIMD_FN(_f4)(x);
+      x = TRAP_SIMD_X(x0, (idx + 4.0), h);  acc1 += TRAP_SIMD_FN(_f4)(x);
+      x = TRAP_SIMD_X(x0, (idx + 8.0), h);  acc2 += TRAP_SIMD_FN(_f4)(x);
+      x = TRAP_SIMD_X(x0, (idx + 12.0), h); acc3 += TRAP_SIMD_FN(_f4)(x);
+      idx += 16.0;
+   }
+   acc0 = (acc0 + acc1) + (acc2 + acc3);
+   sum = (acc0[0] + acc0[1]) + (acc0[2] + acc0[3]);
+
+   return sum + TRAP_SIMD_FN(_scalar)(x0, h, i, last - i);
+}  /* Trap_sum_<name>_avx2 */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_avx512
+ * Purpose:     8 doubles per vector, 4 vector accumulators (32
+ *              samples per iteration)
+ */
+__attribute__ ((target ("avx512f")))
+static double TRAP_SIMD_FN(_avx512)(double x0, double h, long first,
+      long count) {
+   const trap_v8d lane = {0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0};
+   trap_v8d acc0 = {0.0}, acc1 = {0.0}, acc2 = {0.0}, acc3 = {0.0};
+   trap_v8d idx, x;
+   long i, last = first + count;
+   double sum;
+   int k;
+
+   idx = lane + (double) first;
+   for (i = first; i + 32 <= last; i += 32) {
+      x = TRAP_SIMD_X(x0, idx, h);          acc0 += TRAP_SIMD_FN(_f8)(x);
+      x = TRAP_SIMD_X(x0, (idx + 8.0), h);  acc1 += TRAP_SIMD_FN(_f8)(x);
+      x = TRAP_SIMD_X(x0, (idx + 16.0), h); acc2 += TRAP_SIMD_FN(_f8)(x);
+      x = TRAP_SIMD_X(x0, (idx + 24.0), h); acc3 += TRAP_SIMD_FN(_f8)(x);
+      idx += 32.0;
+   }
+   acc0 = (acc0 + acc1) + (acc2 + acc3);
+   sum = 0.0;
+   for (k = 0; k < 8; k++)
+      sum += acc0[k];
+
+   return sum + TRAP_SIMD_FN(_scalar)(x0, h, i, last - i);
+}  /* Trap_sum_<name>_avx512 */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>
+ * Purpose:     Sum of f(x0 + i*h) for i = first, ..., first+count-1,
+ *              using the best version for this CPU
+ * In args:     x0:     left endpoint of the grid
+ *              h:      spacing of the grid
+ *              first:  index of the first sample
+ *              count:  number of samples (may be <= 0)
+ */
+static double TRAP_SIMD_FN()(double x0, double h, long first,
+      long count) {
+   if (count <= 0) return 0.0;
+   switch (Trap_simd_isa()) {
+      case TRAP_ISA_AVX512:
+         return TRAP_SIMD_FN(_avx512)(x0, h, first, count);
+      case TRAP_ISA_AVX2:
+         return TRAP_SIMD_FN(_avx2)(x0, h, first, count);
+      default:
+         return TRAP_SIMD_FN(_scalar)(x0, h, first, count);
+   }
+}  /* Trap_sum_<name> */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_comp_scalar
+ * Purpose:     Compensated version of Trap_sum_<name>_scalar:  two
+ *              independent (sum, error) pairs
+ */
+static double TRAP_SIMD_FN(_comp_scalar)(double x0, double h, long first,
+      long count) {
+   double s0 = 0.0, c0 = 0.0, s1 = 0.0, c1 = 0.0, y0, y1, t, z;
+   long i, last = first + count;
+
+   for (i = first; i + 2 <= last; i += 2) {
+      y0 = TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) i, h));
+      y1 = TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) (i+1), h));
+      TRAP_TWO_SUM(s0, c0, y0, t, z);
+      TRAP_TWO_SUM(s1, c1, y1, t, z);
+   }
+   if (i < last) {
+      y0 = TRAP_SIMD_F(TRAP_SIMD_X(x0, (double) i, h));
+      TRAP_TWO_SUM(s0, c0, y0, t, z);
+   }
+   TRAP_TWO_SUM(s0, c0, s1, t, z);
+
+   return s0 + (c0 + c1);
+}  /* Trap_sum_<name>_comp_scalar */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_comp_avx2
+ * Purpose:     Compensated sum, 4 doubles per vector, 2 vector
+ *              (sum, error) pairs
+ */
+__attribute__ ((target ("avx2,fma")))
+static double TRAP_SIMD_FN(_comp_avx2)(double x0, double h, long first,
+      long count) {
+   const trap_v4d lane = {0.0, 1.0, 2.0, 3.0};
+   trap_v4d s0 = {0.0}, c0 = {0.0}, s1 = {0.0}, c1 = {0.0};
+   trap_v4d idx, y0, y1, t, z;
+   double sum = 0.0, comp = 0.0, tail, ts, zs;
+   long i, last = first + count;
+   int k;
+
+   idx = lane + (double) first;
+   for (i = first; i + 8 <= last; i += 8) {
+      y0 = TRAP_SIMD_FN(_f4)(TRAP_SIMD_X(x0, idx, h));
+      y1 = TRAP_SIMD_FN(_f4)(TRAP_SIMD_X(x0, (idx + 4.0), h));
+      TRAP_TWO_SUM(s0, c0, y0, t, z);
+      TRAP_TWO_SUM(s1, c1, y1, t, z);
+      idx += 8.0;
+   }
+   TRAP_TWO_SUM(s0, c0, s1, t, z);
+   c0 += c1;
+   for (k = 0; k < 4; k++) {
+      TRAP_TWO_SUM(sum, comp, s0[k], ts, zs);
+      comp += c0[k];
+   }
+   tail = TRAP_SIMD_FN(_comp_scalar)(x0, h, i, last - i);
+   TRAP_TWO_SUM(sum, comp, tail, ts, zs);
+
+   return sum + comp;
+}  /* Trap_sum_<name>_comp_avx2 */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_comp_avx512
+ * Purpose:     Compensated sum, 8 doubles per vector, 2 vector
+ *              (sum, error) pairs
+ */
+__attribute__ ((target ("avx512f")))
+static double TRAP_SIMD_FN(_comp_avx512)(double x0, double h, long first,
+      long count) {
+   const trap_v8d lane = {0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0};
+   trap_v8d s0 = {0.0}, c0 = {0.0}, s1 = {0.0}, c1 = {0.0};
+   trap_v8d idx, y0, y1, t, z;
+   double sum = 0.0, comp = 0.0, tail, ts, zs;
+   long i, last = first + count;
+   int k;
+
+   idx = lane + (double) first;
+   for (i = first; i + 16 <= last; i += 16) {
+      y0 = TRAP_SIMD_FN(_f8)(TRAP_SIMD_X(x0, idx, h));
+      y1 = TRAP_SIMD_FN(_f8)(TRAP_SIMD_X(x0, (idx + 8.0), h));
+      TRAP_TWO_SUM(s0, c0, y0, t, z);
+      TRAP_TWO_SUM(s1, c1, y1, t, z);
+      idx += 16.0;
+   }
+   TRAP_TWO_SUM(s0, c0, s1, t, z);
+   c0 += c1;
+   for (k = 0; k < 8; k++) {
+      TRAP_TWO_SUM(sum, comp, s0[k], ts, zs);
+      comp += c0[k];
+   }
+   tail = TRAP_SIMD_FN(_comp_scalar)(x0, h, i, last - i);
+   TRAP_TWO_SUM(sum, comp, tail, ts, zs);
+
+   return sum + comp;
+}  /* Trap_sum_<name>_comp_avx512 */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_comp
+ * Purpose:     Same as Trap_sum_<name>, but the rounding error of
+ *              every addition is kept and added back at the end, so
+ *              the result is almost independent of count
+ */
+static double TRAP_SIMD_FN(_comp)(double x0, double h, long first,
+      long count) {
+   if (count <= 0) return 0.0;
+   switch (Trap_simd_isa()) {
+      case TRAP_ISA_AVX512:
+         return TRAP_SIMD_FN(_comp_avx512)(x0, h, first, count);
+      case TRAP_ISA_AVX2:
+         return TRAP_SIMD_FN(_comp_avx2)(x0, h, first, count);
+      default:
+         return TRAP_SIMD_FN(_comp_scalar)(x0, h, first, count);
+   }
+}  /* Trap_sum_<name>_comp */
+
+/*-------------------------------------------------------------------
+ * Function:    Trap_sum_<name>_pairwise
+ * Purpose:     Same as Trap_sum_<name>, summing blocks of
+ *              TRAP_PAIRWISE_BLOCK samples pairwise
+ */
+static double TRAP_SIMD_FN(_pairwise)(double x0, double h, long first,
+      long count) {
+   trap_sum_t block_sum;
+
+   /* Choose the kernel once, not once per block */
+   switch (Trap_simd_isa()) {
+      case TRAP_ISA_AVX512: block_sum = TRAP_SIMD_FN(_avx512); break;
+      case TRAP_ISA_AVX2:   block_sum = TRAP_SIMD_FN(_avx2);   break;
+      default:              block_sum = TRAP_SIMD_FN(_scalar); break;
+   }
+   if (count <= 0) return 0.0;
+   return Trap_sum_pairwise(block_sum, x0, h, first, count);
+}  /* Trap_sum_<name>_pairwise */
+
+#undef TRAP_SIMD_FN
+#undef TRAP_SIMD_F
+#undef TRAP_SIMD_NAME
+#undef TRAP_SIMD_LANEWISE